@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "src/2C02.h"
@@ -9,114 +10,235 @@
 #include "src/bus.hpp"
 #include "src/controller.h"
 #include "src/mapper.hpp"
-#include "src/mapper_0.hpp"
-#include "src/mapper_1.hpp"
-#include "src/mapper_2.hpp"
-#include "src/mapper_3.hpp"
-#include "src/mapper_4.hpp"
-#include "src/mapper_76.hpp"
+#include "src/movie.h"
+#include "src/profile.h"
+#include "src/rewind.h"
+#include "src/savestate.h"
+#include "src/trace.h"
 #include "src/window.h"
 
+/**
+ * @brief write out what the cpu trace kept and free it
+ *
+ * @param cpu
+ */
+static void finish_trace(State6502 *cpu) {
+    if (!cpu->trace)
+        return;
+
+    FILE *file = cpu->trace->file;
+    dump_trace(cpu->trace, stdout);
+    close_trace(cpu->trace);
+    cpu->trace = NULL;
+
+    if (file)
+        fclose(file);
+}
 
 int main(int argc, char **argv) {
 
-    // get basic game info
-    char *game = (char *) malloc(sizeof(char) * 200);
-    strcpy(game, argv[1]);
-    game[strlen(argv[1]) - 4] = '\0';
-    
+    // parse arguments: rom [scale] [fps] [--headless] [--frames N] [--block-cache] [--idle-skip]
+    //                  [--trace FILE] [--trace-binary FILE] [--trace-ring N] [--load-state FILE] [--save-state FILE]
+    //                  [--rewind MB] [--run-ahead N] [--record FILE] [--play FILE]
+    char *positional[3] = {NULL, NULL, NULL};
+    int num_positional = 0;
+    bool headless = false;
+    bool block_cache = false;
+    bool idle_skip = false;
+    char *trace_path = NULL;
+    bool trace_binary = false;
+    long trace_ring = 0;
+    char *load_path = NULL;
+    char *save_path = NULL;
+    long rewind_budget = -1;
+    long run_ahead = 0;
+    char *record_path = NULL;
+    char *play_path = NULL;
+    long frames = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = atol(argv[++i]);
+        else if (strcmp(argv[i], "--block-cache") == 0)
+            block_cache = true;
+        else if (strcmp(argv[i], "--idle-skip") == 0)
+            idle_skip = true;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (strcmp(argv[i], "--trace-binary") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+            trace_binary = true;
+        }
+        else if (strcmp(argv[i], "--trace-ring") == 0 && i + 1 < argc)
+            trace_ring = atol(argv[++i]);
+        else if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc)
+            load_path = argv[++i];
+        else if (strcmp(argv[i], "--save-state") == 0 && i + 1 < argc)
+            save_path = argv[++i];
+        else if (strcmp(argv[i], "--rewind") == 0 && i + 1 < argc)
+            rewind_budget = atol(argv[++i]);
+        else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
+            run_ahead = atol(argv[++i]);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            record_path = argv[++i];
+        else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc)
+            play_path = argv[++i];
+        else if (num_positional < 3)
+            positional[num_positional++] = argv[i];
+    }
 
-    // create device objects
-    Bus *bus = InitBus();
-    Mapper *mapper;
-    State6502 *cpu = Init6502();
-    State2C02 *ppu = Init2C02();
-    Controller *controller_1 = InitController();
-    Controller *controller_2 = InitController();
-
-    // assign bus to the devices
-    cpu->bus = bus;
-    ppu->bus = bus;
-    controller_1->bus = bus;
-    // controller_2->bus = bus;
-
-    // assign devices to the bus
-    bus->cpu = cpu;
-    bus->ppu = ppu;
-    bus->controller_1 = controller_1;
-    // bus->controller_2 = controller_2;
-
-    // load the rom into a buffer
-    FILE *rom = fopen(argv[1], "rb");
-
-    if (!rom) {
-        fprintf(stderr, "Unable to open rom %s.\n", argv[1]);
+    if (!positional[0]) {
+        fprintf(stderr, "Usage: %s rom [scale] [fps] [--headless] [--frames N] [--block-cache] [--idle-skip] "
+                        "[--trace FILE] [--trace-binary FILE] [--trace-ring N] [--load-state FILE] [--save-state FILE] "
+                        "[--rewind MB] [--run-ahead N] [--record FILE] [--play FILE]\n", argv[0]);
         return 1;
     }
 
-    // get file length
-    fseek(rom, 0, SEEK_END);
-    int file_size = ftell(rom);
-    fseek(rom, 0, SEEK_SET);
+    char *rom_path = positional[0];
 
-    // create buffer and allocate memory
-    uint8_t *buffer = (uint8_t *)malloc(file_size + 1);
-    if (!buffer) {
-        fprintf(stderr, "Memory error!");
-        fclose(rom);
+    // load the rom and create the devices, with the cpu reset
+    uint32_t rom_crc;
+    Bus *bus = InitMachine(rom_path, &rom_crc);
+    if (!bus) {
+        fprintf(stderr, "Unable to load rom %s.\n", rom_path);
         return 1;
     }
 
-    // read file contents into buffer
-    fread(buffer, file_size, 1, rom);
-    fclose(rom);
-
-    // get the right mapper and set correct functions
-    uint16_t mapper_number = (buffer[7] & 0xf0) | (buffer[6] >> 0x4);
-    switch (mapper_number) {
-        case 0:
-            // mapper interface for NROM
-            mapper = new Mapper_0(game, mapper_number, buffer, bus);
-            break;
-
-        case 1:
-            // mapper interface for MMC1
-            mapper = new Mapper_1(game, mapper_number, buffer, bus);
-            break;
-
-        case 2:
-            // mapper interface for UNROM
-            mapper = new Mapper_2(game, mapper_number, buffer, bus);
-            break;
-
-        case 3:
-            // mapper interface for CNROM
-            mapper = new Mapper_3(game, mapper_number, buffer, bus);
-            break;
-
-        case 4:
-            // mapper interface for MMC3
-            mapper = new Mapper_4(game, mapper_number, buffer, bus);
-            break;
-        
-        case 76:
-            // mapper interface for Mapper 076
-            mapper = new Mapper_76(game, mapper_number, buffer, bus);
-            break;
-
-        default:
-            exit(0);
-            break;
+    State6502 *cpu = bus->cpu;
+    State2C02 *ppu = bus->ppu;
+    Controller *controller_1 = bus->controller_1;
+    Controller *controller_2 = bus->controller_2;
+    Mapper *mapper = bus->mapper;
+    char *game = mapper->game;
+
+    if (block_cache)
+        enable_block_cache(cpu, mapper->prg_rom, mapper->prg_rom_size);
+    if (idle_skip)
+        enable_idle_loop_skip(cpu);
+
+    // trace every instruction from reset, either all of it to a file (text or binary, see
+    // tools/trace_decode.cpp) or the last lines to stdout at exit. without a trace, / toggles tracing to stdout
+    if (trace_path) {
+        FILE *trace_file = fopen(trace_path, trace_binary ? "wb" : "w");
+        if (!trace_file) {
+            fprintf(stderr, "Unable to open trace file %s.\n", trace_path);
+            return 1;
+        }
+        cpu->trace = trace_binary ? InitBinaryTrace(trace_file) : InitFileTrace(trace_file);
+        cpu->debug = true;
+    }
+    else if (trace_ring > 0) {
+        cpu->trace = InitRingTrace(trace_ring);
+        cpu->debug = true;
+    }
+
+    // continue from a saved state instead of power on. F5 saves to <game>.state and F9 loads it back
+    SaveState *state = InitSaveState();
+    char *state_path = (char *) malloc(sizeof(char) * 210);
+    snprintf(state_path, 210, "%s.state", game);
+
+    if (load_path) {
+        if (!read_state_file(state, load_path) || !load_state(bus, state)) {
+            fprintf(stderr, "Unable to load state %s.\n", load_path);
+            return 1;
+        }
+    }
+
+    // record both controllers every frame from here, or play a recording back from where it started.
+    // movies only play on the rom they were recorded with
+    Movie *movie = NULL;
+    if (play_path) {
+        movie = read_movie_file(play_path);
+        if (!movie) {
+            fprintf(stderr, "Unable to read movie %s.\n", play_path);
+            return 1;
+        }
+        if (movie->rom_crc != rom_crc || !start_movie(movie, bus)) {
+            fprintf(stderr, "Movie %s was recorded with another rom.\n", play_path);
+            return 1;
+        }
+    }
+    else if (record_path) {
+        movie = InitMovie(bus, rom_crc);
     }
 
-    // initialize addressable space
-    bus->mapper = mapper;
-    mapper->initialize();
+    // headless runs need an end point, a movie's length by default
+    if (headless && frames <= 0)
+        frames = (movie && !movie->recording) ? movie->frames : 600;
+
+    // keep the last frames to step back through with backspace, on by default with a window.
+    // keyframes every 2 seconds, at most 30 minutes of frames, whichever fits in the budget
+    if (rewind_budget < 0)
+        rewind_budget = headless ? 0 : 16;
+    Rewind *rewind = NULL;
+    if (rewind_budget > 0)
+        rewind = InitRewind(rewind_budget << 20, 60 * 60 * 30, 120);
+
+    // show the frame N frames ahead of the one the game is on, so input shows up N frames sooner
+    SaveState *ahead_state = NULL;
+    if (run_ahead > 0)
+        ahead_state = InitSaveState();
+
+    // run as fast as possible without a window and report throughput
+    if (headless) {
+        uint64_t first_instruction = cpu->instructions;
+        uint64_t first_dot = bus->system_cycles;
+        clock_t start = clock();
+        for (long frame = 0; frame < frames; frame++) {
+            if (movie && movie->recording)
+                record_movie_frame(movie, bus);
+            else if (movie)
+                play_movie_frame(movie, bus);
+
+            if (!run_frame_ahead(bus, ahead_state, run_ahead)) {
+                fprintf(stderr, "Unable to go back after running ahead.\n");
+                return 1;
+            }
+            if (rewind)
+                record_rewind_frame(rewind, bus);
+        }
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (seconds <= 0)
+            seconds = 1.0 / CLOCKS_PER_SEC;
+
+        printf("frames: %ld in %.3f s\n", frames, seconds);
+        printf("frames/second: %.1f\n", frames / seconds);
+        printf("cpu instructions/second: %.0f\n", (cpu->instructions - first_instruction) / seconds);
+        printf("ppu dots/second: %.0f\n", (bus->system_cycles - first_dot) / seconds);
+        if (cpu->block_cache)
+            printf("instructions from the block cache: %.1f%%\n", 100.0 * cpu->block_cache->instructions / cpu->instructions);
+        if (cpu->idle_loop)
+            printf("cpu cycles skipped in idle loops: %llu (%.1f%%)\n", (unsigned long long)cpu->idle_loop->skipped_cycles,
+                   100.0 * cpu->idle_loop->skipped_cycles / (bus->cpu_clock / 3));
+        if (save_path) {
+            save_state(bus, state);
+            if (!write_state_file(state, save_path)) {
+                fprintf(stderr, "Unable to save state %s.\n", save_path);
+                return 1;
+            }
+        }
+        if (rewind)
+            printf("rewind: %u frames in %u bytes\n", rewind->count, rewind_bytes_used(rewind));
+
+        // the same movie always ends on the same picture, compare it between runs
+        printf("last frame crc32: %08x\n", rom_crc32(ppu->frame_buffer, 256 * 240));
+#ifdef NES_COUNTERS
+        print_counters(stdout, mapper->mapper_number);
+#endif
+        if (movie && movie->recording && !write_movie_file(movie, record_path)) {
+            fprintf(stderr, "Unable to write movie %s.\n", record_path);
+            return 1;
+        }
+        finish_trace(cpu);
+        return 0;
+    }
 
     // set up SDL and window
     int scale = 2;
-    if (argc == 3) {
-        scale = atoi(argv[2]);
+    if (positional[1]) {
+        scale = atoi(positional[1]);
     }
     init_SDL();
     SDL_Window *window = create_window(game, SDL_WINDOWPOS_CENTERED, 256 * scale, 240 * scale);
@@ -140,67 +262,122 @@ int main(int argc, char **argv) {
     // initialize input
     uint8_t *pressed_keys = (uint8_t *)SDL_GetKeyboardState(NULL);
 
-    // reset cpu
-    reset(cpu);
-
     // initialize timers/fps
     clock_t start = clock();
     clock_t diff = clock() - start;
     
     int fps = 60;
-    if (argc == 4) {
-        fps = atoi(argv[3]);
+    if (positional[2]) {
+        fps = atoi(positional[2]);
     }
 
     bool paused = false;
 
     while (!quit) {
-        // progress logic
-        if(!paused)
-            clock_bus(bus, window);
-
-        // read input
+        // read input, from the keyboard unless a movie is playing
         pressed_keys = (uint8_t *)SDL_GetKeyboardState(NULL);
-        set_controller(controller_1, pressed_keys);
 
-        // render only after vblank
-        if ((!paused && ppu->scanline == 241 && ppu->cycles == 1) || paused) {
-            while (((diff * 1000) / CLOCKS_PER_SEC) < (1000.0 / fps)) {
-                diff = clock() - start;
+        // progress logic, one frame at a time. holding backspace steps back instead
+        if (rewind && pressed_keys[SDL_SCANCODE_BACKSPACE]) {
+            if (rewind_frame(rewind, bus) && movie)
+                rewind_movie_frame(movie);
+        }
+        else if (!paused) {
+            if (!movie || movie->recording || !play_movie_frame(movie, bus))
+                set_controller(controller_1, pressed_keys);
+            if (movie && movie->recording)
+                record_movie_frame(movie, bus);
+
+            if (!run_frame_ahead(bus, ahead_state, run_ahead)) {
+                printf("Unable to go back after running ahead.\n");
+                quit = true;
             }
+            if (rewind)
+                record_rewind_frame(rewind, bus);
+        }
 
-            start = clock();
+        // stop after a fixed number of frames if requested
+        if (frames > 0 && ppu->frame_count >= frames)
+            quit = true;
+
+        // render after vblank
+        while (((diff * 1000) / CLOCKS_PER_SEC) < (1000.0 / fps)) {
             diff = clock() - start;
+        }
+
+        start = clock();
+        diff = clock() - start;
+
+        render_frame(ppu, window);
+        SDL_UpdateWindowSurface(window);
+
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_KEYDOWN) {
+                switch (event.key.keysym.sym) {
+                    case SDLK_ESCAPE:
+                        quit = true;
+                        break;
+                    
+                    case SDLK_p:
+                        paused = !paused;
+                        break;
+
+                    case SDLK_SLASH:
+                        cpu->debug = !cpu->debug;
+                        break;
+
+                    case SDLK_F5:
+                        save_state(bus, state);
+                        if (!write_state_file(state, state_path))
+                            printf("Unable to save state %s.\n", state_path);
+                        break;
+
+                    case SDLK_F9:
+                        if (!read_state_file(state, state_path) || !load_state(bus, state))
+                            printf("Unable to load state %s.\n", state_path);
+                        break;
+
+#ifdef NES_COUNTERS
+                    // counts since the last dump, to compare one part of a game with another
+                    case SDLK_F2:
+                        print_counters(stdout, mapper->mapper_number);
+                        reset_counters();
+                        break;
+#endif
 
-            SDL_UpdateWindowSurface(window);
-
-            while (SDL_PollEvent(&event)) {
-                if (event.type == SDL_KEYDOWN) {
-                    switch (event.key.keysym.sym) {
-                        case SDLK_ESCAPE:
-                            quit = true;
-                            mapper->cleanup();
-                            free(cpu);
-                            free(ppu);
-                            free(mapper);
-                            free(bus);
-                            free(controller_1);
-                            free(window);
-                            break;
-                        
-                        case SDLK_p:
-                            paused = !paused;
-                            break;
-
-                        case SDLK_SLASH:
-                            cpu->debug = !cpu->debug;
-                            break;
-
-                    }
                 }
             }
         }
     }
 
+    if (save_path) {
+        save_state(bus, state);
+        if (!write_state_file(state, save_path))
+            printf("Unable to save state %s.\n", save_path);
+    }
+
+    if (movie && movie->recording && !write_movie_file(movie, record_path))
+        printf("Unable to write movie %s.\n", record_path);
+
+#ifdef NES_COUNTERS
+    print_counters(stdout, mapper->mapper_number);
+#endif
+    finish_trace(cpu);
+    free_save_state(state);
+    if (rewind)
+        free_rewind(rewind);
+    if (ahead_state)
+        free_save_state(ahead_state);
+    free(state_path);
+    mapper->cleanup();
+    free(cpu);
+    free(ppu);
+    free(mapper);
+    free(bus);
+    free(controller_1);
+    free(controller_2);
+    if (movie)
+        free_movie(movie);
+
     return 0;
 }
\ No newline at end of file
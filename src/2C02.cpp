@@ -12,8 +12,31 @@ const int SYSTEM_PALETTE[0x40] = {
 
 };
 
+// each byte with its bits in reverse order
+static const uint8_t REVERSED_BITS[0x100] = {
+    0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+    0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8, 0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+    0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4, 0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+    0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec, 0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+    0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2, 0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+    0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea, 0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+    0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6, 0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+    0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee, 0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+    0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1, 0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+    0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9, 0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+    0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5, 0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+    0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed, 0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+    0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3, 0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+    0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb, 0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+    0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7, 0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+    0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef, 0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff
+};
+
+// every bit of a pattern byte spread into its own byte, leftmost pixel first
+static uint64_t TILE_ROW_BITS[0x100];
+
 State2C02 *Init2C02() {
-    State2C02 *state = (State2C02 *)malloc(sizeof(State2C02));
+    State2C02 *state = (State2C02 *)calloc(1, sizeof(State2C02));
 
     state->primary_oam = (Sprite *)malloc(sizeof(Sprite) * 0x40);
     state->secondary_oam = (Sprite *)malloc(sizeof(Sprite) * 0x08);
@@ -36,12 +59,31 @@ State2C02 *Init2C02() {
     state->tram_address.reg = 0;
     state->sprite_shifter_pattern_lo = (uint8_t *)malloc(0x8);
     state->sprite_shifter_pattern_hi = (uint8_t *)malloc(0x8);
+    state->sprite_rows = (uint64_t *)calloc(0x8, sizeof(uint64_t));
+
+    state->scanline_sprites = (uint8_t *)malloc(240 * 8);
+    state->scanline_sprite_count = (uint8_t *)malloc(240);
+    state->sprite_index_dirty = true;
 
     state->bus = NULL;
     state->cycles = 0;
     state->scanline = 0;
+    state->nmi = false;
+    state->frame_complete = false;
+    state->frame_count = 0;
 
-    state->oamdma_clock = 0;
+
+    state->frame_buffer = (uint8_t *)malloc(256 * 240);
+    memset(state->frame_buffer, 0, 256 * 240);
+    state->skip_pixels = false;
+    state->mirror_mode = VERTICAL;
+
+    for (int byte = 0; byte < 0x100; byte++) {
+        uint64_t row = 0;
+        for (int pixel = 0; pixel < 8; pixel++)
+            row |= (uint64_t)((byte >> (7 - pixel)) & 1) << (pixel * 8);
+        TILE_ROW_BITS[byte] = row;
+    }
 
     return state;
 }
@@ -53,11 +95,77 @@ State2C02 *Init2C02() {
  * @return uint8_t
  */
 uint8_t flip_byte(uint8_t byte) {
-    uint8_t result = 0;
-    for (int i = 0; i < 8; i++) {
-        result |= ((byte >> i) & 1) << (7 - i);
+    return REVERSED_BITS[byte];
+}
+
+/**
+ * @brief ppu address of the low bitplane byte of a sprite's row on the current scanline
+ *
+ * @param ppu
+ * @param sprite
+ * @return uint16_t
+ */
+uint16_t sprite_row_address(State2C02 *ppu, Sprite *sprite) {
+    int row = ppu->scanline - sprite->y;
+    bool flip_vertical = (sprite->attributes >> 7) & 0x1;
+
+    if (ppu->control.sprite_height == 0) {
+        uint8_t y_offset = flip_vertical ? 7 - row : row;
+        return (ppu->control.sprite_tile_select * 0x1000) + (sprite->tile_index * 0x10) + y_offset;
+    }
+
+    // 8x16 sprites take their pattern table from bit 0 of the tile index, the bottom half is the next tile
+    bool bottom_half = (row >= 8) != flip_vertical;
+    return ((sprite->tile_index & 0x01) << 12) | (((sprite->tile_index & 0xfe) + bottom_half) << 4) | ((flip_vertical ? 7 - row : row) & 0x07);
+}
+
+/**
+ * @brief rebuild the list of sprites in range of each scanline from primary oam
+ *
+ * @param ppu
+ */
+void build_sprite_index(State2C02 *ppu) {
+    int height = ppu->control.sprite_height ? 16 : 8;
+    memset(ppu->scanline_sprite_count, 0, 240);
+
+    for (int n = 0; n < 64; n++) {
+        for (int line = ppu->primary_oam[n].y; line < ppu->primary_oam[n].y + height && line < 240; line++) {
+            uint8_t count = ppu->scanline_sprite_count[line];
+            if (count < 8)
+                ppu->scanline_sprites[line * 8 + count] = n;
+
+            // counts past 8 only matter for overflow
+            if (count < 9)
+                ppu->scanline_sprite_count[line] = count + 1;
+        }
+    }
+
+    ppu->sprite_index_dirty = false;
+}
+
+/**
+ * @brief copy a 256 byte cpu page into oam, starting at OAMADDR
+ *
+ * @param ppu
+ * @param page high byte of the source address
+ */
+void oam_dma(State2C02 *ppu, uint8_t page) {
+    COUNT(oam_dmas);
+    uint8_t *oam = (uint8_t *)ppu->primary_oam;
+    uint8_t *source = ppu->bus->cpu_read_pages[page];
+    uint8_t start = ppu->oamaddr.address;
+
+    if (source) {
+        memcpy(oam + start, source, 0x100 - start);
+        memcpy(oam, source + (0x100 - start), start);
     }
-    return result;
+
+    else {
+        for (int i = 0; i < 0x100; i++)
+            oam[(uint8_t)(start + i)] = cpu_read_from_bus(ppu->bus, (page << 8) | i);
+    }
+
+    ppu->sprite_index_dirty = true;
 }
 
 /**
@@ -71,6 +179,9 @@ void write_to_ppu_register(State2C02 *ppu, uint16_t address, uint8_t value) {
     ppu->io_db = value;
     switch (address) {
         case 0x00:  // control
+            if (((value >> 5) & 0x1) != ppu->control.sprite_height)
+                ppu->sprite_index_dirty = true;
+
             ppu->control.reg = value;
             ppu->tram_address.nametable_y = (ppu->control.nametable_select & 0x2) >> 1;
             ppu->tram_address.nametable_x = ppu->control.nametable_select & 0x1;
@@ -91,6 +202,7 @@ void write_to_ppu_register(State2C02 *ppu, uint16_t address, uint8_t value) {
             switch ((ppu->oamaddr.address % 4)) {
                 case 0:
                     ppu->primary_oam[ppu->oamaddr.address / 4].y = value;
+                    ppu->sprite_index_dirty = true;
                     break;
                 case 1:
                     ppu->primary_oam[ppu->oamaddr.address / 4].tile_index = value;
@@ -148,7 +260,7 @@ void write_to_ppu_register(State2C02 *ppu, uint16_t address, uint8_t value) {
 
         case 0x4014:  // OAMDMA
             ppu->oamdma.address_high_byte = value;
-            ppu->oamdma_write = true;
+            oam_dma(ppu, value);
             break;
     }
 }
@@ -207,7 +319,7 @@ uint8_t read_from_ppu_register(State2C02 *ppu, uint16_t address) {
 }
 
 /**
- * @brief set the mirror mode
+ * @brief set the mirror mode and rebuild the bus nametable map
  *
  * @param ppu
  * @param mirror_mode
@@ -242,6 +354,38 @@ void set_mirror_mode(State2C02 *ppu, uint8_t mirror_mode) {
             ppu->mirror_mode = mirror_mode ? VERTICAL : HORIZONTAL;
             break;
     }
+
+    // cartridges with their own vram ignore the mapper's mirroring
+    if (ppu->bus->mapper->buffer[6] & 0x8)
+        ppu->mirror_mode = FOUR_SCREEN;
+
+    Bus *bus = ppu->bus;
+    switch (ppu->mirror_mode) {
+        case SINGLE_SCREEN_LOWER:
+            bus->name_tables[0] = bus->name_tables[1] = bus->name_tables[2] = bus->name_tables[3] = bus->name_table_0;
+            break;
+
+        case SINGLE_SCREEN_UPPER:
+            bus->name_tables[0] = bus->name_tables[1] = bus->name_tables[2] = bus->name_tables[3] = bus->name_table_1;
+            break;
+
+        case HORIZONTAL:
+            bus->name_tables[0] = bus->name_tables[1] = bus->name_table_0;
+            bus->name_tables[2] = bus->name_tables[3] = bus->name_table_1;
+            break;
+
+        case FOUR_SCREEN:
+            bus->name_tables[0] = bus->name_table_0;
+            bus->name_tables[1] = bus->name_table_1;
+            bus->name_tables[2] = bus->name_table_2;
+            bus->name_tables[3] = bus->name_table_3;
+            break;
+
+        default:
+            bus->name_tables[0] = bus->name_tables[2] = bus->name_table_0;
+            bus->name_tables[1] = bus->name_tables[3] = bus->name_table_1;
+            break;
+    }
 }
 /**
  * @brief render pattern tables to window
@@ -327,6 +471,48 @@ void render_nametables(State2C02 *ppu, SDL_Window *window) {
     SDL_UpdateWindowSurface(window);
 }
 
+/**
+ * @brief convert the frame buffer to RGB and scale it to the window surface
+ *
+ * @param ppu
+ * @param window
+ */
+void render_frame(State2C02 *ppu, SDL_Window *window) {
+    SDL_Surface *surface = SDL_GetWindowSurface(window);
+    int scale = surface->w / 256;
+    if (surface->h / 240 < scale)
+        scale = surface->h / 240;
+    if (scale < 1)
+        return;
+
+    draw_frame(ppu, (uint32_t *)surface->pixels, surface->pitch / sizeof(uint32_t), scale);
+}
+
+/**
+ * @brief convert the frame buffer to RGB and scale it into a 32 bit pixel buffer
+ *
+ * @param ppu
+ * @param pixels at least 256 * scale by 240 * scale
+ * @param pitch pixels per row of the buffer
+ * @param scale
+ */
+void draw_frame(State2C02 *ppu, uint32_t *pixels, int pitch, int scale) {
+    for (int y = 0; y < 240; y++) {
+        uint8_t *source = &ppu->frame_buffer[y * 256];
+        uint32_t *row = pixels + (y * scale) * pitch;
+
+        // nearest neighbour: widen the first row, then copy it down
+        for (int x = 0; x < 256; x++) {
+            uint32_t color = SYSTEM_PALETTE[source[x] & 0x3f];
+            for (int i = 0; i < scale; i++)
+                row[x * scale + i] = color;
+        }
+
+        for (int i = 1; i < scale; i++)
+            memcpy(row + i * pitch, row, 256 * scale * sizeof(uint32_t));
+    }
+}
+
 /**
  * @brief print nametables to file
  *
@@ -494,48 +680,7 @@ void update_sprite_shifters(State2C02 *ppu) {
  *
  * @param ppu
  */
-void clock_ppu(State2C02 *ppu, SDL_Window *window) {
-    // OAM DMA
-    if (ppu->oamdma_write && ppu->cycles % 3 == 0) {
-        // read (do nothing)
-        if (ppu->oamdma_clock % 2 == 0)
-            ;
-
-        // write
-        else {
-            // printf("WRITING SPRITE!\n");
-            uint16_t address = (ppu->oamdma.address_high_byte << 8) | (ppu->oamdma_clock / 2);
-            uint8_t value = cpu_read_from_bus(ppu->bus, address);
-            switch (ppu->oamdma_clock % 8) {
-                case 1:
-                    ppu->primary_oam[ppu->oamaddr.address / 4].y = value;
-                    break;
-
-                case 3:
-                    ppu->primary_oam[ppu->oamaddr.address / 4].tile_index = value;
-                    break;
-
-                case 5:
-                    ppu->primary_oam[ppu->oamaddr.address / 4].attributes = value;
-                    break;
-
-                case 7:
-                    ppu->primary_oam[ppu->oamaddr.address / 4].x = value;
-                    break;
-            }
-            ppu->oamaddr.address++;
-        }
-
-        if (ppu->oamdma_clock == 511) {
-            ppu->oamdma_clock = 0;
-            ppu->oamdma_write = false;
-        }
-
-        else {
-            ppu->oamdma_clock++;
-        }
-    }
-
+void clock_ppu(State2C02 *ppu) {
     // load backgrounds and sprites for the current scanline
     if (ppu->scanline >= -1 && ppu->scanline < 240) {
         // odd cycle switch
@@ -615,32 +760,31 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
 
             for (int i = 0; i < 8; i++) {
                 ppu->sprite_shifter_pattern_lo[i] = 0;
+                ppu->sprite_rows[i] = 0;
                 ppu->sprite_shifter_pattern_hi[i] = 0;
             }
 
-            while (n < 64 && ppu->sprite_count < 9) {
-                // check if sprite is in a valid y range
-                int difference = ppu->scanline - ppu->primary_oam[n].y;
-                if (difference >= 0 && difference < (ppu->control.sprite_height ? 16 : 8)) {
-                    if (ppu->sprite_count < 8) {
-                        ppu->secondary_oam[ppu->sprite_count].y = ppu->primary_oam[n].y;
-                        ppu->secondary_oam[ppu->sprite_count].tile_index = ppu->primary_oam[n].tile_index;
-                        ppu->secondary_oam[ppu->sprite_count].attributes = ppu->primary_oam[n].attributes;
-                        ppu->secondary_oam[ppu->sprite_count].x = ppu->primary_oam[n].x;
-
-                        // increment sprite count
-                        ppu->sprite_count++;
-
-                        if (n == 0) {
-                            ppu->sprite_zero_on_scanline = true;
-                        }
-                    }
+            // sprites in range of this scanline, in oam order
+            if (ppu->sprite_index_dirty)
+                build_sprite_index(ppu);
+
+            uint8_t *candidates = &ppu->scanline_sprites[ppu->scanline * 8];
+            uint8_t in_range = ppu->scanline_sprite_count[ppu->scanline];
+
+            while (ppu->sprite_count < 8 && ppu->sprite_count < in_range) {
+                n = candidates[ppu->sprite_count];
+                ppu->secondary_oam[ppu->sprite_count] = ppu->primary_oam[n];
+
+                if (n == 0) {
+                    ppu->sprite_zero_on_scanline = true;
                 }
-                // increment primary oam pointer
-                n++;
+
+                // increment sprite count
+                ppu->sprite_count++;
             }
 
-            ppu->status.sprite_overflow = (ppu->sprite_count > 8);
+            if (in_range > 8)
+                ppu->status.sprite_overflow = 1;
         }
 
         // garbage nametable reads, load sprite shifters
@@ -655,93 +799,26 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
                 // sprite shifters
                 else if ((ppu->cycles - 261) % 8 == 0) {
                     int i = (ppu->cycles - 257) / 8;
-                    bool flip_vertical = (ppu->secondary_oam[i].attributes & 0x80) > 0;
-                    bool flip_horizontal = (ppu->secondary_oam[i].attributes >> 6) & 0x1;
-
-                    if (ppu->control.sprite_height == 0) {
-                        uint8_t y_offset = flip_vertical ? (7 - (ppu->scanline - ppu->secondary_oam[i].y)) : (ppu->scanline - ppu->secondary_oam[i].y);
-                        uint8_t pattern_index = ppu->secondary_oam[i].tile_index;
-
-                        ppu->sprite_shifter_pattern_lo[i] = ppu_read_from_bus(ppu->bus, (ppu->control.sprite_tile_select * 0x1000) + (pattern_index * 0x10) + y_offset);
-                    }
-
-                    else {
-                        // 8x16 mode
-                        uint8_t pattern_index = ppu->secondary_oam[i].tile_index;
-                        uint8_t y_offset = (ppu->scanline - ppu->secondary_oam[i].y);
-                        if (!flip_vertical) {
-                            if (ppu->scanline - ppu->secondary_oam[i].y < 8)                                                                                // top half of tile
-                                ppu->sprite_shifter_pattern_lo[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)           // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | ((ppu->secondary_oam[i].tile_index & 0xfe) << 4)      // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((ppu->scanline - ppu->secondary_oam[i].y) & 0x07));  // Which Row in cell? (0->7)
-
-                            else                                                                                                                              // bottom half of tile
-                                ppu->sprite_shifter_pattern_lo[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)             // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | (((ppu->secondary_oam[i].tile_index & 0xfe) + 1) << 4)  // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((ppu->scanline - ppu->secondary_oam[i].y) & 0x07));    // Which Row in cell? (0->7)
-                        }
-
-                        else {
-                            if (ppu->scanline - ppu->secondary_oam[i].y < 8)                                                                                      // bottom half of tile
-                                ppu->sprite_shifter_pattern_lo[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)                 // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | (((ppu->secondary_oam[i].tile_index & 0xfe) + 1) << 4)      // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((7 - (ppu->scanline - ppu->secondary_oam[i].y)) & 0x07));  // Which Row in cell? (0->7)
+                    ppu->sprite_row_address = sprite_row_address(ppu, &ppu->secondary_oam[i]);
 
-                            else                                                                                                                                  // top half of tile
-                                ppu->sprite_shifter_pattern_lo[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)                 // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | ((ppu->secondary_oam[i].tile_index & 0xfe) << 4)            // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((7 - (ppu->scanline - ppu->secondary_oam[i].y)) & 0x07));  // Which Row in cell? (0->7)
-                        }
-                    }
-
-                    if (flip_horizontal)
+                    ppu->sprite_shifter_pattern_lo[i] = ppu_read_from_bus(ppu->bus, ppu->sprite_row_address);
+                    if ((ppu->secondary_oam[i].attributes >> 6) & 0x1)
                         ppu->sprite_shifter_pattern_lo[i] = flip_byte(ppu->sprite_shifter_pattern_lo[i]);
                 }
 
                 else if ((ppu->cycles - 263) % 8 == 0) {
                     int i = (ppu->cycles - 257) / 8;
-                    bool flip_vertical = (ppu->secondary_oam[i].attributes >> 7) & 0x1;
                     bool flip_horizontal = (ppu->secondary_oam[i].attributes >> 6) & 0x1;
 
-                    if (ppu->control.sprite_height == 0) {
-                        uint8_t y_offset = flip_vertical ? (7 - (ppu->scanline - ppu->secondary_oam[i].y)) : (ppu->scanline - ppu->secondary_oam[i].y);
-                        uint8_t pattern_index = ppu->secondary_oam[i].tile_index;
-                        ppu->sprite_shifter_pattern_hi[i] = ppu_read_from_bus(ppu->bus, (ppu->control.sprite_tile_select * 0x1000) + (pattern_index * 0x10) + y_offset + 8);
-
-                    }
-
-                    else {
-                        // 8x16 mode
-                        uint8_t pattern_index = ppu->secondary_oam[i].tile_index;
-                        uint8_t y_offset = (ppu->scanline - ppu->secondary_oam[i].y);
-                        if (!flip_vertical) {
-                            if (ppu->scanline - ppu->secondary_oam[i].y < 8)                                                                                    // top half of tile
-                                ppu->sprite_shifter_pattern_hi[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)               // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | ((ppu->secondary_oam[i].tile_index & 0xfe) << 4)          // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((ppu->scanline - ppu->secondary_oam[i].y) & 0x07) + 8);  // Which Row in cell? (0->7)
-
-                            else                                                                                                                                // bottom half of tile
-                                ppu->sprite_shifter_pattern_hi[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)               // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | (((ppu->secondary_oam[i].tile_index & 0xfe) + 1) << 4)    // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((ppu->scanline - ppu->secondary_oam[i].y) & 0x07) + 8);  // Which Row in cell? (0->7)
-                        }
-
-                        else {
-                            if (ppu->scanline - ppu->secondary_oam[i].y < 8)                                                                                          // bottom half of tile
-                                ppu->sprite_shifter_pattern_hi[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)                     // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | (((ppu->secondary_oam[i].tile_index & 0xfe) + 1) << 4)          // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((7 - (ppu->scanline - ppu->secondary_oam[i].y)) & 0x07) + 8);  // Which Row in cell? (0->7)
-
-                            else                                                                                                                                      // top half of tile
-                                ppu->sprite_shifter_pattern_hi[i] = ppu_read_from_bus(ppu->bus, ((ppu->secondary_oam[i].tile_index & 0x01) << 12)                     // Which Pattern Table? 0KB or 4KB offset
-                                                                                                    | ((ppu->secondary_oam[i].tile_index & 0xfe) << 4)                // Which Cell? Tile ID * 16 (16 bytes per tile)
-                                                                                                    | ((7 - (ppu->scanline - ppu->secondary_oam[i].y)) & 0x07) + 8);  // Which Row in cell? (0->7)
-                        }
-                    }
-
-                    if (flip_horizontal) {
+                    ppu->sprite_shifter_pattern_hi[i] = ppu_read_from_bus(ppu->bus, ppu->sprite_row_address + 8);
+                    if (flip_horizontal)
                         ppu->sprite_shifter_pattern_hi[i] = flip_byte(ppu->sprite_shifter_pattern_hi[i]);
-                    }
+
+                    // garbage fetches (pre-render line) can straddle tiles, expand those from the fetched bytes
+                    if (ppu->sprite_row_address < 0x2000 && !(ppu->sprite_row_address & 0x8))
+                        ppu->sprite_rows[i] = chr_tile_row(ppu->bus, ppu->sprite_row_address, flip_horizontal);
+                    else
+                        ppu->sprite_rows[i] = TILE_ROW_BITS[ppu->sprite_shifter_pattern_lo[i]] | (TILE_ROW_BITS[ppu->sprite_shifter_pattern_hi[i]] << 1);
                 }
             }
         }
@@ -761,9 +838,7 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
 
     // rendering
     if ((ppu->scanline >= 0 && ppu->scanline < 240) && (ppu->cycles >= 1 && ppu->cycles < 257)) {
-        int scale = SDL_GetWindowSurface(window)->w / 256;
-        int x_start = (ppu->cycles - 1) * scale;
-        int y_start = ppu->scanline * scale;
+        uint8_t *pixel = &ppu->frame_buffer[ppu->scanline * 256 + (ppu->cycles - 1)];
 
         // background rendering
         uint8_t bg_pixel = 0x00;
@@ -788,14 +863,7 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
             }
         }
 
-        int x = x_start;
-        int y = y_start;
-
-        for (int i = 0; i < scale * scale; i++) {
-            x = x_start + (i % scale);
-            y = y_start + (i / scale);
-            set_pixel(window, x, y, SYSTEM_PALETTE[ppu_read_from_bus(ppu->bus, palette_address)]);
-        }
+        *pixel = ppu_read_from_bus(ppu->bus, palette_address);
 
         // sprite rendering
         uint8_t sprite_pixel = 0x00;
@@ -832,14 +900,7 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
                             sprite_palette = ppu->secondary_oam[i].attributes & 0x3;
                             palette_address |= (sprite_palette << 2) | (sprite_pixel & 0x3);
 
-                            int x = x_start;
-                            int y = y_start;
-
-                            for (int i = 0; i < scale * scale; i++) {
-                                x = x_start + (i % scale);
-                                y = y_start + (i / scale);
-                                set_pixel(window, x, y, SYSTEM_PALETTE[ppu_read_from_bus(ppu->bus, 0x3f00 | palette_address)]);
-                            }
+                            *pixel = ppu_read_from_bus(ppu->bus, 0x3f00 | palette_address);
                             break;
                         }
                     }
@@ -855,12 +916,8 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
                 // left column mode
                 if (!(ppu->mask.background_left_column_enable && ppu->mask.sprite_left_column_enable)) {
                     // correct x location
-                    if (ppu->cycles > 8 && ppu->cycles + 7 < 256) {
+                    if (ppu->cycles > 8 && ppu->cycles + 7 < 256)
                         ppu->status.sprite_zero_hit = 1;
-                        
-                        printf("Sprite zero hit, left column disabled!\n");
-                        printf("Value of PPUMASK = $%02x\n", ppu->mask.reg);
-                    }
                 }
 
                 else {
@@ -876,6 +933,8 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
     // vblank and nmi
     if (ppu->scanline >= 241 && ppu->scanline < 261) {
         if (ppu->scanline == 241 && ppu->cycles == 1) {
+            ppu->frame_complete = true;
+            ppu->frame_count++;
             ppu->status.vblank = 1;
             if (ppu->control.nmi_enable)
                 ppu->nmi = true;
@@ -892,4 +951,280 @@ void clock_ppu(State2C02 *ppu, SDL_Window *window) {
             ppu->scanline = -1;
         }
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief execute cycles 0-256 of a visible scanline at once, with the same results as clock_ppu
+ *
+ * @param ppu
+ * @return uint32_t number of cycles run, 0 if the scanline has to go through clock_ppu
+ */
+uint32_t clock_ppu_scanline(State2C02 *ppu) {
+    if (ppu->scanline < 0 || ppu->scanline >= 240 || ppu->cycles != 0 || ppu->status.vblank)
+        return 0;
+
+    // the first cycle of scanline 0 is skipped
+    uint32_t cycles_run = (ppu->scanline == 0) ? 256 : 257;
+
+    Bus *bus = ppu->bus;
+    uint8_t *pixels = &ppu->frame_buffer[ppu->scanline * 256];
+    bool rendering = ppu->mask.background_enable || ppu->mask.sprite_enable;
+
+    if (!rendering) {
+        memset(pixels, bus->palette[0], 256);
+        ppu->cycles = 257;
+        return cycles_run;
+    }
+
+    // without pixels, a line is only composed when sprite 0 could still hit on it
+    bool compose = !ppu->skip_pixels || (!ppu->status.sprite_zero_hit && ppu->sprite_zero_on_scanline);
+
+    // background line as palette offsets (palette << 2 | pixel)
+    uint8_t background[34 * 8];
+
+    // background tiles 0 and 1 are already in the shifters, 2-33 are fetched across the scanline
+    uint8_t pattern_lo[34], pattern_hi[34], attribute_lo[34], attribute_hi[34];
+    pattern_lo[0] = ppu->bg_shifter_pattern_lo >> 8;
+    pattern_lo[1] = ppu->bg_shifter_pattern_lo & 0xff;
+    pattern_hi[0] = ppu->bg_shifter_pattern_hi >> 8;
+    pattern_hi[1] = ppu->bg_shifter_pattern_hi & 0xff;
+    attribute_lo[0] = ppu->bg_shifter_attribute_lo >> 8;
+    attribute_lo[1] = ppu->bg_shifter_attribute_lo & 0xff;
+    attribute_hi[0] = ppu->bg_shifter_attribute_hi >> 8;
+    attribute_hi[1] = ppu->bg_shifter_attribute_hi & 0xff;
+
+    for (int tile = 2; tile < 34; tile++) {
+        // the first tile index was fetched at the end of the previous scanline
+        if (tile > 2)
+            ppu->bg_next_tile_index = bus->name_tables[ppu->vram_address.nametable_y * 2 + ppu->vram_address.nametable_x][ppu->vram_address.coarse_y * 32 + ppu->vram_address.coarse_x];
+
+        ppu->bg_next_tile_attribute = bus->name_tables[ppu->vram_address.nametable_y * 2 + ppu->vram_address.nametable_x][0x3c0 | ((ppu->vram_address.coarse_y >> 2) << 3) | (ppu->vram_address.coarse_x >> 2)];
+        if (ppu->vram_address.coarse_y & 0x2)
+            ppu->bg_next_tile_attribute >>= 4;
+        if (ppu->vram_address.coarse_x & 0x2)
+            ppu->bg_next_tile_attribute >>= 2;
+        ppu->bg_next_tile_attribute &= 0x3;
+
+        uint16_t pattern_address = (ppu->control.background_tile_select * 0x1000) | ((uint16_t)ppu->bg_next_tile_index * 0x10) | ppu->vram_address.fine_y;
+        ppu->bg_next_tile_lsb = bus->chr_windows[pattern_address >> 10][pattern_address & 0x03ff];
+        ppu->bg_next_tile_msb = bus->chr_windows[(pattern_address + 8) >> 10][(pattern_address + 8) & 0x03ff];
+
+        pattern_lo[tile] = ppu->bg_next_tile_lsb;
+        pattern_hi[tile] = ppu->bg_next_tile_msb;
+        attribute_lo[tile] = (ppu->bg_next_tile_attribute & 0b01) ? 0xff : 0x00;
+        attribute_hi[tile] = (ppu->bg_next_tile_attribute & 0b10) ? 0xff : 0x00;
+
+        if (ppu->mask.background_enable && compose && tile < 33) {
+            uint64_t row = chr_tile_row(bus, pattern_address, false) | (0x0101010101010101ULL * (ppu->bg_next_tile_attribute << 2));
+            memcpy(&background[tile * 8], &row, 8);
+        }
+
+        increment_scroll_x(ppu);
+    }
+    increment_scroll_y(ppu);
+
+    if (ppu->mask.background_enable) {
+        // the shifted in tiles can hold partial attributes, expand them bit by bit
+        for (int tile = 0; tile < 2 && compose; tile++) {
+            uint64_t row = TILE_ROW_BITS[pattern_lo[tile]] | (TILE_ROW_BITS[pattern_hi[tile]] << 1) | (TILE_ROW_BITS[attribute_lo[tile]] << 2) | (TILE_ROW_BITS[attribute_hi[tile]] << 3);
+            memcpy(&background[tile * 8], &row, 8);
+        }
+
+        // shifters end 7 shifts past the load of tile 32
+        ppu->bg_shifter_pattern_lo = ((pattern_lo[31] << 8 | pattern_lo[32]) << 7) & 0xffff;
+        ppu->bg_shifter_pattern_hi = ((pattern_hi[31] << 8 | pattern_hi[32]) << 7) & 0xffff;
+        ppu->bg_shifter_attribute_lo = ((attribute_lo[31] << 8 | attribute_lo[32]) << 7) & 0xffff;
+        ppu->bg_shifter_attribute_hi = ((attribute_hi[31] << 8 | attribute_hi[32]) << 7) & 0xffff;
+    }
+
+    else {
+        // loaded but never shifted
+        ppu->bg_shifter_pattern_lo = (ppu->bg_shifter_pattern_lo & 0xff00) | pattern_lo[32];
+        ppu->bg_shifter_pattern_hi = (ppu->bg_shifter_pattern_hi & 0xff00) | pattern_hi[32];
+        ppu->bg_shifter_attribute_lo = (ppu->bg_shifter_attribute_lo & 0xff00) | attribute_lo[32];
+        ppu->bg_shifter_attribute_hi = (ppu->bg_shifter_attribute_hi & 0xff00) | attribute_hi[32];
+    }
+
+    // sprite line, lowest index opaque sprite wins: bit 7 sprite zero, bit 6 behind background
+    uint8_t sprites[256];
+    if (ppu->mask.sprite_enable) {
+        memset(sprites, 0, sizeof(sprites));
+        for (int i = ppu->sprite_count - 1; i >= 0; i--) {
+            Sprite *sprite = &ppu->secondary_oam[i];
+            uint8_t flags = (i == 0 ? 0x80 : 0x00) | (((sprite->attributes >> 5) & 0x1) << 6) | ((sprite->attributes & 0x3) << 2);
+
+            uint8_t row[8];
+            memcpy(row, &ppu->sprite_rows[i], 8);
+
+            // sprite shifters stop at cycle 255, so pixel 255 repeats pixel 254
+            for (int column = 0; column < 8 && sprite->x + column < 255; column++) {
+                if (row[column] != 0)
+                    sprites[sprite->x + column] = flags | row[column];
+            }
+
+            int shifts = 254 - (sprite->x < 254 ? sprite->x : 254);
+            ppu->sprite_shifter_pattern_lo[i] = shifts < 8 ? ppu->sprite_shifter_pattern_lo[i] << shifts : 0;
+            ppu->sprite_shifter_pattern_hi[i] = shifts < 8 ? ppu->sprite_shifter_pattern_hi[i] << shifts : 0;
+            sprite->x = sprite->x > 254 ? sprite->x - 254 : 0;
+        }
+        sprites[255] = sprites[254];
+    }
+
+    // the last pixel is all that's left of sprite_zero_rendered after the line
+    if (!compose) {
+        if (ppu->mask.sprite_enable)
+            ppu->sprite_zero_rendered = sprites[255] & 0x80;
+
+        ppu->cycles = 257;
+        return cycles_run;
+    }
+
+    // compose
+    for (int x = 0; x < 256; x++) {
+        bool left_column = x >= 8 || ppu->mask.background_left_column_enable;
+
+        uint8_t bg_pixel = 0x00;
+        uint8_t palette_offset = 0x00;
+        if (ppu->mask.background_enable && left_column) {
+            palette_offset = background[x + ppu->fine_x];
+            bg_pixel = palette_offset & 0x3;
+        }
+
+        pixels[x] = bus->palette[bg_pixel ? palette_offset : 0];
+
+        if (ppu->mask.sprite_enable) {
+            ppu->sprite_zero_rendered = false;
+
+            if (left_column && sprites[x]) {
+                if (sprites[x] & 0x80)
+                    ppu->sprite_zero_rendered = true;
+
+                if (!((sprites[x] & 0x40) && bg_pixel != 0))
+                    pixels[x] = bus->palette[0x10 | (sprites[x] & 0xf)];
+            }
+        }
+
+        // sprite 0 hit detection
+        if (!ppu->status.sprite_zero_hit && bg_pixel != 0 && ppu->sprite_zero_on_scanline && ppu->sprite_zero_rendered) {
+            if (ppu->mask.background_enable && ppu->mask.sprite_enable) {
+                if (!(ppu->mask.background_left_column_enable && ppu->mask.sprite_left_column_enable)) {
+                    if (x >= 8 && x <= 247)
+                        ppu->status.sprite_zero_hit = 1;
+                }
+
+                else {
+                    ppu->status.sprite_zero_hit = 1;
+                }
+            }
+        }
+    }
+
+    ppu->cycles = 257;
+    return cycles_run;
+}
+
+/**
+ * @brief lower bound on the ppu cycles left before vblank starts (and an nmi can be raised)
+ *
+ * @param ppu
+ * @return uint32_t
+ */
+uint32_t cycles_until_vblank(State2C02 *ppu) {
+    int32_t cycles = (241 - ppu->scanline) * 341 + (1 - ppu->cycles);
+    if (cycles < 0)
+        cycles += 262 * 341;
+
+    // the skipped cycle at the start of scanline 0 may still be ahead
+    return cycles > 0 ? cycles - 1 : 0;
+}
+
+/**
+ * @brief lower bound on the ppu cycles left before a read of PPUSTATUS can give a different value, if the
+ * cpu does not write to the ppu in the meantime
+ *
+ * @param ppu
+ * @return uint32_t
+ */
+uint32_t cycles_until_status_change(State2C02 *ppu) {
+    uint32_t cycles = cycles_until_vblank(ppu);
+
+    // all three flags are cleared at cycle 1 of the pre-render scanline
+    if (ppu->scanline >= 241) {
+        uint32_t until_clear = (260 - ppu->scanline) * 341 + (341 - ppu->cycles);
+        return cycles < until_clear ? cycles : until_clear;
+    }
+    if (ppu->scanline == -1 && ppu->cycles <= 1)
+        return 1 - ppu->cycles;
+
+    bool rendering = ppu->mask.background_enable || ppu->mask.sprite_enable;
+
+    // sprite 0 is found at cycle 257 of the scanline before the one it's drawn on (scanline 0 draws what 239
+    // found), so the index below, which only covers scanlines still to be evaluated, misses a hit on the
+    // scanline being drawn or the next one
+    if (rendering && !ppu->status.sprite_zero_hit && ppu->sprite_zero_on_scanline) {
+        if (ppu->scanline >= 0 && ppu->cycles <= 257)
+            return 0;
+        if (ppu->scanline < 239)
+            return 341 - ppu->cycles - 1;
+    }
+
+    // sprite overflow is set at cycle 257 of a scanline with more than 8 sprites in range, and sprite 0 hit
+    // on the scanline after one sprite 0 is in range of
+    if (ppu->sprite_index_dirty)
+        build_sprite_index(ppu);
+
+    int first = ppu->cycles <= 257 ? ppu->scanline : ppu->scanline + 1;
+    for (int scanline = first < 0 ? 0 : first; scanline < 240; scanline++) {
+        uint8_t in_range = ppu->scanline_sprite_count[scanline];
+        bool overflow = in_range > 8 && !ppu->status.sprite_overflow;
+        bool hit = rendering && !ppu->status.sprite_zero_hit && in_range > 0 &&
+                   ppu->scanline_sprites[scanline * 8] == 0;
+
+        if (overflow || hit) {
+            int32_t until_scanline = (scanline - ppu->scanline) * 341 - ppu->cycles;
+
+            // the skipped cycle at the start of scanline 0 may still be ahead
+            until_scanline--;
+            if (until_scanline <= 0)
+                return 0;
+
+            return (uint32_t)until_scanline < cycles ? until_scanline : cycles;
+        }
+    }
+
+    return cycles;
+}
+
+/**
+ * @brief where the ppu will be after running more cycles, without running them
+ *
+ * @param ppu
+ * @param cycles
+ * @param scanline
+ * @param cycle
+ */
+void ppu_position_after(State2C02 *ppu, uint64_t cycles, int *scanline, int *cycle) {
+    // cycles since the start of the pre-render scanline
+    uint32_t position = (ppu->scanline + 1) * 341 + ppu->cycles;
+
+    while (cycles > 0) {
+        // cycle 0 of scanline 0 runs cycle 1 as well
+        if (position == 341) {
+            position = 343;
+            cycles--;
+            continue;
+        }
+
+        uint32_t boundary = position < 341 ? 341 : 262 * 341;
+        if (cycles < boundary - position) {
+            position += cycles;
+            break;
+        }
+
+        cycles -= boundary - position;
+        position = boundary == 341 ? 341 : 0;
+    }
+
+    *scanline = position / 341 - 1;
+    *cycle = position % 341;
+}
@@ -7,6 +7,7 @@
 #define SINGLE_SCREEN_UPPER 0
 #define VERTICAL 2
 #define HORIZONTAL 3
+#define FOUR_SCREEN 4
 
 typedef union Control {
     struct {
@@ -124,13 +125,15 @@ typedef struct State2C02 {
     uint8_t sprite_count;
     uint8_t *sprite_shifter_pattern_lo;
     uint8_t *sprite_shifter_pattern_hi;
+    uint64_t *sprite_rows;          // decoded pixels of each fetched sprite row, for clock_ppu_scanline
+    uint16_t sprite_row_address;
     bool sprite_found;
     bool sprite_zero_on_scanline;
     bool sprite_zero_rendered;
 
-    // OAMDMA
-    bool oamdma_write;
-    int oamdma_clock;
+    uint8_t *scanline_sprites;        // up to 8 oam indices in range of each visible scanline
+    uint8_t *scanline_sprite_count;   // sprites in range of each scanline, 9 means overflow
+    bool sprite_index_dirty;          // set when a sprite y or the sprite height changes
 
     // IO
     uint8_t data_buffer;
@@ -147,10 +150,16 @@ typedef struct State2C02 {
     uint16_t bg_shifter_attribute_lo;
     uint16_t bg_shifter_attribute_hi;
 
+    // OUTPUT
+    uint8_t *frame_buffer;  // 256x240 system palette indices
+    bool skip_pixels;       // frames nobody sees: clock_ppu_scanline only works out what the emulation depends on
+
     // PPU STATUS
     int scanline;
     int cycles;
     bool nmi;
+    bool frame_complete;  // set at the start of vblank, cleared by run_frame
+    uint32_t frame_count;
 
     // BUS
     struct Bus *bus;
@@ -171,6 +180,21 @@ State2C02 *Init2C02();
  */
 void ppu_add_cycles(State2C02 *ppu, uint8_t count);
 
+/**
+ * @brief rebuild the list of sprites in range of each scanline from primary oam
+ *
+ * @param ppu
+ */
+void build_sprite_index(State2C02 *ppu);
+
+/**
+ * @brief copy a 256 byte cpu page into oam, starting at OAMADDR
+ *
+ * @param ppu
+ * @param page high byte of the source address
+ */
+void oam_dma(State2C02 *ppu, uint8_t page);
+
 /**
  * @brief write to ppu register
  *
@@ -190,7 +214,7 @@ void write_to_ppu_register(State2C02 *ppu, uint16_t address, uint8_t value);
 uint8_t read_from_ppu_register(State2C02 *ppu, uint16_t address);
 
 /**
- * @brief set the mirror mode
+ * @brief set the mirror mode and rebuild the bus nametable map
  *
  * @param ppu
  * @param mirror_mode
@@ -212,6 +236,24 @@ void render_pattern_tables(State2C02 *ppu, SDL_Window *window);
  */
 void render_nametables(State2C02 *ppu, SDL_Window *window);
 
+/**
+ * @brief convert the frame buffer to RGB and scale it into a 32 bit pixel buffer
+ *
+ * @param ppu
+ * @param pixels at least 256 * scale by 240 * scale
+ * @param pitch pixels per row of the buffer
+ * @param scale
+ */
+void draw_frame(State2C02 *ppu, uint32_t *pixels, int pitch, int scale);
+
+/**
+ * @brief convert the frame buffer to RGB and scale it to the window surface
+ *
+ * @param ppu
+ * @param window
+ */
+void render_frame(State2C02 *ppu, SDL_Window *window);
+
 /**
  * @brief print nametables to file
  *
@@ -273,4 +315,39 @@ void update_sprite_shifters(State2C02 *ppu);
  *
  * @param ppu
  */
-void clock_ppu(State2C02 *ppu, SDL_Window *window);
\ No newline at end of file
+void clock_ppu(State2C02 *ppu);
+
+/**
+ * @brief execute cycles 0-256 of a visible scanline at once, with the same results as clock_ppu
+ *
+ * @param ppu
+ * @return uint32_t number of cycles run, 0 if the scanline has to go through clock_ppu
+ */
+uint32_t clock_ppu_scanline(State2C02 *ppu);
+
+/**
+ * @brief lower bound on the ppu cycles left before vblank starts (and an nmi can be raised)
+ *
+ * @param ppu
+ * @return uint32_t
+ */
+uint32_t cycles_until_vblank(State2C02 *ppu);
+
+/**
+ * @brief lower bound on the ppu cycles left before a read of PPUSTATUS can give a different value, if the
+ * cpu does not write to the ppu in the meantime
+ *
+ * @param ppu
+ * @return uint32_t
+ */
+uint32_t cycles_until_status_change(State2C02 *ppu);
+
+/**
+ * @brief where the ppu will be after running more cycles, without running them
+ *
+ * @param ppu
+ * @param cycles
+ * @param scanline
+ * @param cycle
+ */
+void ppu_position_after(State2C02 *ppu, uint64_t cycles, int *scanline, int *cycle);
\ No newline at end of file
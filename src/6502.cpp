@@ -3,6 +3,7 @@
 #include "2C02.h"
 #include "Disassemble6502.h"
 #include "bus.hpp"
+#include "trace.h"
 
 /************************ CREATE OBJECT ************************/
 
@@ -21,12 +22,11 @@ State6502 *Init6502(void) {
     cpu->x = 0;
     cpu->y = 0;
 
-    cpu->sr.n = 0;
+    cpu->sr.nz = 1;
     cpu->sr.v = 0;
     cpu->sr.b = 0;
     cpu->sr.d = 0;
     cpu->sr.i = 0;
-    cpu->sr.z = 0;
     cpu->sr.c = 0;
 
     cpu->sp = 0xff;
@@ -35,14 +35,81 @@ State6502 *Init6502(void) {
     cpu->int_enable = 0;
     cpu->halted = 0;
     cpu->cycles = 0;
+    cpu->instructions = 0;
 
     cpu->bus = NULL;
+    cpu->block_cache = NULL;
+    cpu->idle_loop = NULL;
+    cpu->trace = NULL;
 
     cpu->debug = false;
 
     return cpu;
 }
 
+/************************ BUS ACCESS ************************/
+
+/**
+ * @brief cpu read, taking one cpu cycle
+ *
+ * @param cpu
+ * @param address
+ * @return uint8_t
+ */
+static inline uint8_t cpu_read(State6502 *cpu, uint16_t address) {
+    uint8_t value = cpu_read_from_bus(cpu->bus, address);
+    cpu->bus->cpu_clock += 3;
+    return value;
+}
+
+/**
+ * @brief cpu write, taking one cpu cycle
+ *
+ * @param cpu
+ * @param address
+ * @param value
+ */
+static inline void cpu_write(State6502 *cpu, uint16_t address, uint8_t value) {
+    cpu_write_to_bus(cpu->bus, address, value);
+    cpu->bus->cpu_clock += 3;
+}
+
+/**
+ * @brief the cycle between the read and the write of a read-modify-write instruction. the 6502 writes the
+ * value it read back in it, which is left out: mmc1 ignores the second of two writes on consecutive cycles,
+ * and the mapper here doesn't filter them
+ *
+ * @param cpu
+ */
+static inline void modify_cycle(State6502 *cpu) {
+    cpu->bus->cpu_clock += 3;
+}
+
+/**
+ * @brief whether an instruction stores to or read-modify-writes its effective address, rather than only
+ * reading it. in the 6502's opcode layout those are $80-$9F and the shift/increment columns outside $A0-$BF
+ *
+ * @param opcode
+ * @return bool
+ */
+static inline bool writes_memory(uint8_t opcode) {
+    return (opcode >> 5) == 4 || ((opcode & 0x2) && (opcode >> 5) != 5);
+}
+
+/**
+ * @brief the read an indexed addressing mode makes before the carry reaches the high byte of the address.
+ * reads only take it when the index crosses a page, stores and read-modify-writes always do
+ *
+ * @param cpu
+ * @param opcode
+ * @param base address before indexing
+ * @param address address after indexing
+ */
+static inline void indexed_dummy_read(State6502 *cpu, uint8_t *opcode, uint16_t base, uint16_t address) {
+    if ((address & 0xff00) != (base & 0xff00) || writes_memory(opcode[0]))
+        cpu_read(cpu, (base & 0xff00) | (address & 0x00ff));
+}
+
 /************************ ADDRESSING MODES ************************/
 
 uint16_t zero_page(State6502 *cpu, uint8_t *opcode) {
@@ -80,41 +147,79 @@ uint16_t absolute(State6502 *cpu, uint8_t *opcode) {
 }
 
 uint16_t absolute_x(State6502 *cpu, uint8_t *opcode) {
-    uint16_t address = (cpu->x + (opcode[2] << 8 | opcode[1]));
-    if ((address & 0xFF00) != (opcode[2] << 8))
-        cpu->cycles++;
+    uint16_t base = opcode[2] << 8 | opcode[1];
+    uint16_t address = base + cpu->x;
+    indexed_dummy_read(cpu, opcode, base, address);
 
     return address;
 }
 
 uint16_t absolute_y(State6502 *cpu, uint8_t *opcode) {
-    uint16_t address = (cpu->y + (opcode[2] << 8 | opcode[1]));
-    if ((address & 0xFF00) != (opcode[2] << 8))
-        cpu->cycles++;
+    uint16_t base = opcode[2] << 8 | opcode[1];
+    uint16_t address = base + cpu->y;
+    indexed_dummy_read(cpu, opcode, base, address);
 
     return address;
 }
 
 uint16_t x_indexed_indirect(State6502 *cpu, uint8_t *opcode) {
     uint8_t index = (opcode[1] + cpu->x) & 0xff;
-    return (cpu_read_from_bus(cpu->bus, (index + 1) & 0xff) << 8) | cpu_read_from_bus(cpu->bus, index);
+    return (cpu_read(cpu, (index + 1) & 0xff) << 8) | cpu_read(cpu, index);
 }
 
 uint16_t indirect_y_indexed(State6502 *cpu, uint8_t *opcode) {
     uint16_t t = opcode[1];
-    uint16_t lo = cpu_read_from_bus(cpu->bus, t & 0x00FF);
-    uint16_t hi = cpu_read_from_bus(cpu->bus, (t + 1) & 0x00FF);
-
-    uint16_t address = (hi << 8) | lo;
-    address += cpu->y;
+    uint16_t lo = cpu_read(cpu, t & 0x00FF);
+    uint16_t hi = cpu_read(cpu, (t + 1) & 0x00FF);
 
-    if ((address & 0xFF00) != (hi << 8))
-        cpu->cycles++;
+    uint16_t base = (hi << 8) | lo;
+    uint16_t address = base + cpu->y;
+    indexed_dummy_read(cpu, opcode, base, address);
 
     return address;
 }
 
 /************************ STATUS REGISTER FUNCTIONS ************************/
+/**
+ * @brief negative flag
+ *
+ * @param cpu
+ * @return bool
+ */
+static inline bool negative_flag(State6502 *cpu) {
+    return (cpu->sr.nz & 0x180) != 0;
+}
+
+/**
+ * @brief zero flag
+ *
+ * @param cpu
+ * @return bool
+ */
+static inline bool zero_flag(State6502 *cpu) {
+    return (cpu->sr.nz & 0xff) == 0;
+}
+
+/**
+ * @brief carry flag
+ *
+ * @param cpu
+ * @return bool
+ */
+static inline bool carry_flag(State6502 *cpu) {
+    return cpu->sr.c;
+}
+
+/**
+ * @brief overflow flag
+ *
+ * @param cpu
+ * @return bool
+ */
+static inline bool overflow_flag(State6502 *cpu) {
+    return cpu->sr.v;
+}
+
 /**
  * @brief Get all the status register flags in one byte
  *
@@ -124,13 +229,13 @@ uint16_t indirect_y_indexed(State6502 *cpu, uint8_t *opcode) {
 static inline uint8_t get_status_register(State6502 *cpu) {
     uint8_t status_register = 0;
 
-    status_register |= (cpu->sr.n << 7) & 0xff;
+    status_register |= (negative_flag(cpu) << 7) & 0xff;
     status_register |= (cpu->sr.v << 6) & 0xff;
     status_register |= (1 << 5) & 0xff;
     status_register |= (cpu->sr.b << 4) & 0xff;
     status_register |= (cpu->sr.d << 3) & 0xff;
     status_register |= (cpu->sr.i << 2) & 0xff;
-    status_register |= (cpu->sr.z << 1) & 0xff;
+    status_register |= (zero_flag(cpu) << 1) & 0xff;
     status_register |= (cpu->sr.c << 0) & 0xff;
 
     return status_register;
@@ -145,12 +250,13 @@ static inline uint8_t get_status_register(State6502 *cpu) {
 static inline void set_status_register(State6502 *cpu, uint8_t byte) {
     // printf("STATUS REGISTER TO BET SET TO = %02x\n", byte);
     cpu->sr.c = (byte >> 0) & 0x1;
-    cpu->sr.z = (byte >> 1) & 0x1;
     cpu->sr.i = (byte >> 2) & 0x1;
     cpu->sr.d = (byte >> 3) & 0x1;
     cpu->sr.b = (byte >> 4) & 0x0;
     cpu->sr.v = (byte >> 6) & 0x1;
-    cpu->sr.n = (byte >> 7) & 0x1;
+
+    // n goes to bit 8 so that n and z can both be set
+    cpu->sr.nz = ((byte & 0x80) << 1) | ((byte & 0x02) ^ 0x02);
 }
 
 /**
@@ -161,8 +267,7 @@ static inline void set_status_register(State6502 *cpu, uint8_t byte) {
  * @param value the result of an operation to updates flags based on
  */
 static inline void update_zn(State6502 *cpu, uint8_t value) {
-    cpu->sr.z = (value == 0) ? 1 : 0;  // zero
-    cpu->sr.n = (value >> 7) ? 1 : 0;  // negative
+    cpu->sr.nz = value;
 }
 
 /**
@@ -173,8 +278,7 @@ static inline void update_zn(State6502 *cpu, uint8_t value) {
  * @param value value provided
  */
 static inline void bit(State6502 *cpu, uint8_t value) {
-    cpu->sr.z = (cpu->a & value) == 0;
-    cpu->sr.n = value >> 7 & 0x1;
+    cpu->sr.nz = ((value & 0x80) << 1) | (cpu->a & value);
     cpu->sr.v = value >> 6 & 0x1;
 }
 
@@ -219,9 +323,12 @@ static inline void xor_a(State6502 *cpu, uint8_t value) {
  * @param address address of the value to shift
  */
 static inline void asl_memory(State6502 *cpu, uint16_t address) {
-    cpu->sr.c = cpu_read_from_bus(cpu->bus, address) >> 7 & 0x1;
-    cpu_write_to_bus(cpu->bus, address, cpu_read_from_bus(cpu->bus, address) << 1);
-    update_zn(cpu, cpu_read_from_bus(cpu->bus, address));
+    uint8_t value = cpu_read(cpu, address);
+    cpu->sr.c = value >> 7 & 0x1;
+    value <<= 1;
+    modify_cycle(cpu);
+    cpu_write(cpu, address, value);
+    update_zn(cpu, value);
 }
 
 /**
@@ -243,10 +350,13 @@ static inline void asl_a(State6502 *cpu) {
  * @param address address of the value to shift
  */
 static inline void rol_memory(State6502 *cpu, uint16_t address) {
-    bool cy = (cpu_read_from_bus(cpu->bus, address) >> 7) & 0x1;
-    cpu_write_to_bus(cpu->bus, address, cpu_read_from_bus(cpu->bus, address) << 1 | cpu->sr.c);
+    uint8_t value = cpu_read(cpu, address);
+    bool cy = (value >> 7) & 0x1;
+    value = value << 1 | cpu->sr.c;
+    modify_cycle(cpu);
+    cpu_write(cpu, address, value);
     cpu->sr.c = cy;
-    update_zn(cpu, cpu_read_from_bus(cpu->bus, address));
+    update_zn(cpu, value);
 }
 
 /**
@@ -269,10 +379,13 @@ static inline void rol_a(State6502 *cpu) {
  * @param address address of the value to shift
  */
 static inline void ror_memory(State6502 *cpu, uint16_t address) {
-    bool cy = (cpu_read_from_bus(cpu->bus, address)) & 0x1;
-    cpu_write_to_bus(cpu->bus, address, cpu_read_from_bus(cpu->bus, address) >> 1 | (cpu->sr.c << 7));
+    uint8_t value = cpu_read(cpu, address);
+    bool cy = value & 0x1;
+    value = value >> 1 | (cpu->sr.c << 7);
+    modify_cycle(cpu);
+    cpu_write(cpu, address, value);
     cpu->sr.c = cy;
-    update_zn(cpu, cpu_read_from_bus(cpu->bus, address));
+    update_zn(cpu, value);
 }
 
 /**
@@ -294,9 +407,12 @@ static inline void ror_a(State6502 *cpu) {
  * @param address address of the value to shift
  */
 static inline void lsr_memory(State6502 *cpu, uint16_t address) {
-    cpu->sr.c = cpu_read_from_bus(cpu->bus, address) & 0x1;
-    cpu_write_to_bus(cpu->bus, address, cpu_read_from_bus(cpu->bus, address) >> 1);
-    update_zn(cpu, cpu_read_from_bus(cpu->bus, address));
+    uint8_t value = cpu_read(cpu, address);
+    cpu->sr.c = value & 0x1;
+    value >>= 1;
+    modify_cycle(cpu);
+    cpu_write(cpu, address, value);
+    update_zn(cpu, value);
 }
 
 /**
@@ -332,7 +448,7 @@ static inline void cmp(State6502 *cpu, uint8_t register_value,
  * @param value the value to be pushed to the stack
  */
 static inline void push(State6502 *cpu, uint8_t value) {
-    cpu_write_to_bus(cpu->bus, (0x0100) | (cpu->sp), value);
+    cpu_write(cpu, (0x0100) | (cpu->sp), value);
     cpu->sp--;
     stack_val = value;
 }
@@ -345,7 +461,7 @@ static inline void push(State6502 *cpu, uint8_t value) {
  */
 static uint8_t pop(State6502 *cpu) {
     cpu->sp++;
-    uint8_t value = cpu_read_from_bus(cpu->bus, (0x0100 | cpu->sp));
+    uint8_t value = cpu_read(cpu, (0x0100 | cpu->sp));
     return value;
 }
 
@@ -386,7 +502,7 @@ static uint16_t pop_16(State6502 *cpu) {
  * @param address address to store accumulator at
  */
 static inline void sta(State6502 *cpu, uint16_t address) {
-    cpu_write_to_bus(cpu->bus, address, cpu->a);
+    cpu_write(cpu, address, cpu->a);
 }
 
 /**
@@ -396,7 +512,7 @@ static inline void sta(State6502 *cpu, uint16_t address) {
  * @param address address to store accumulator at
  */
 static inline void sty(State6502 *cpu, uint16_t address) {
-    cpu_write_to_bus(cpu->bus, address, cpu->y);
+    cpu_write(cpu, address, cpu->y);
 }
 
 /**
@@ -406,7 +522,7 @@ static inline void sty(State6502 *cpu, uint16_t address) {
  * @param address address to store accumulator at
  */
 static inline void stx(State6502 *cpu, uint16_t address) {
-    cpu_write_to_bus(cpu->bus, address, cpu->x);
+    cpu_write(cpu, address, cpu->x);
 }
 
 /**
@@ -507,10 +623,11 @@ static inline void lda(State6502 *cpu, uint8_t value) {
  * @param cpu
  */
 void reset(State6502 *cpu) {
-    cpu->pc = (cpu_read_from_bus(cpu->bus, 0xfffd) << 8) | (cpu_read_from_bus(cpu->bus, 0xfffc));
+    uint64_t start = cpu->bus->cpu_clock;
+    cpu->pc = (cpu_read(cpu, 0xfffd) << 8) | cpu_read(cpu, 0xfffc);
 
-    cpu->pc = (cpu_read_from_bus(cpu->bus, 0xfffd) << 8) | cpu_read_from_bus(cpu->bus, 0xfffc);
-    cpu->cycles += 7;
+    // the sequence is 7 cycles long and runs outside take_interrupts, the vector reads paid for two of them
+    cpu->bus->cpu_clock = start + 3 * 7;
 }
 
 /**
@@ -519,10 +636,14 @@ void reset(State6502 *cpu) {
  * @param cpu
  */
 void irq(State6502 *cpu) {
+    COUNT(irqs);
+    // the two cycles before the pushes read the next opcode and throw it away
+    cpu_read(cpu, cpu->pc);
+    cpu_read(cpu, cpu->pc);
     push_16(cpu, cpu->pc);
     push(cpu, get_status_register(cpu));
     cpu->sr.i = 1;
-    cpu->pc = (cpu_read_from_bus(cpu->bus, 0xffff) << 8) | cpu_read_from_bus(cpu->bus, 0xfffe);
+    cpu->pc = (cpu_read(cpu, 0xffff) << 8) | cpu_read(cpu, 0xfffe);
     cpu->cycles += 7;
 }
 
@@ -532,9 +653,13 @@ void irq(State6502 *cpu) {
  * @param cpu
  */
 void nmi(State6502 *cpu) {
+    COUNT(nmis);
+    // the two cycles before the pushes read the next opcode and throw it away
+    cpu_read(cpu, cpu->pc);
+    cpu_read(cpu, cpu->pc);
     push_16(cpu, cpu->pc);
     push(cpu, get_status_register(cpu));
-    cpu->pc = (cpu_read_from_bus(cpu->bus, 0xfffb) << 8) | cpu_read_from_bus(cpu->bus, 0xfffa);
+    cpu->pc = (cpu_read(cpu, 0xfffb) << 8) | cpu_read(cpu, 0xfffa);
     cpu->cycles += 7;
 }
 
@@ -546,12 +671,21 @@ void nmi(State6502 *cpu) {
  * @param value offset to move PC by
  */
 static inline void branch(State6502 *cpu, uint8_t offset) {
+    // a taken branch reads the next opcode and throws it away, and again from the wrong page if the target
+    // is on another one than the next instruction
+    uint16_t next = cpu->pc + 2;
+    cpu_read(cpu, next);
+
     if ((offset >> 7) & 1) {
         offset = ~offset + 1;
         cpu->pc = cpu->pc - offset;
     } else {
         cpu->pc = cpu->pc + offset;  // negative represented by two's complement
     }
+
+    uint16_t target = cpu->pc + 2;
+    if ((target & 0xff00) != (next & 0xff00))
+        cpu_read(cpu, (next & 0xff00) | (target & 0x00ff));
 }
 
 /**
@@ -642,8 +776,10 @@ static inline void dex(State6502 *cpu) {
  * @param address address of memory to increment
  */
 static inline void inc(State6502 *cpu, uint16_t address) {
-    cpu_write_to_bus(cpu->bus, address, cpu_read_from_bus(cpu->bus, address) + 1);
-    update_zn(cpu, cpu_read_from_bus(cpu->bus, address));
+    uint8_t value = cpu_read(cpu, address) + 1;
+    modify_cycle(cpu);
+    cpu_write(cpu, address, value);
+    update_zn(cpu, value);
 }
 
 /**
@@ -653,8 +789,10 @@ static inline void inc(State6502 *cpu, uint16_t address) {
  * @param address address of memory to decrement
  */
 static inline void dec(State6502 *cpu, uint16_t address) {
-    cpu_write_to_bus(cpu->bus, address, cpu_read_from_bus(cpu->bus, address) - 1);
-    update_zn(cpu, cpu_read_from_bus(cpu->bus, address));
+    uint8_t value = cpu_read(cpu, address) - 1;
+    modify_cycle(cpu);
+    cpu_write(cpu, address, value);
+    update_zn(cpu, value);
 }
 
 /************************ ILLEGAL/MISCELLANEOUS ************************/
@@ -667,6 +805,7 @@ static inline void dec(State6502 *cpu, uint16_t address) {
  */
 static inline void slo(State6502 *cpu, uint16_t address) {
     asl_memory(cpu, address);
+    // the result is the value just written, reading it back is not another bus cycle
     or_a(cpu, cpu_read_from_bus(cpu->bus, address));
 }
 
@@ -752,8 +891,8 @@ static inline void arr(State6502 *cpu, uint8_t value) {
  * @param cpu
  */
 static inline void sha(State6502 *cpu, uint16_t address) {
-    uint8_t value = cpu_read_from_bus(cpu->bus, (address >> 8) & 0xff + 1) & cpu->a & cpu->x;
-    cpu_write_to_bus(cpu->bus, address, value);
+    uint8_t value = cpu_read(cpu, (address >> 8) & 0xff + 1) & cpu->a & cpu->x;
+    cpu_write(cpu, address, value);
 }
 
 /**
@@ -763,7 +902,7 @@ static inline void sha(State6502 *cpu, uint16_t address) {
  * @param address
  */
 static inline void sax(State6502 *cpu, uint16_t address) {
-    cpu_write_to_bus(cpu->bus, address, cpu->a & cpu->x);
+    cpu_write(cpu, address, cpu->a & cpu->x);
 }
 
 /**
@@ -784,8 +923,8 @@ static inline void tas(State6502 *cpu, uint16_t address) {
  * @param address
  */
 static inline void shx(State6502 *cpu, uint16_t address) {
-    uint8_t value = cpu->x & cpu_read_from_bus(cpu->bus, (address >> 8) & 0xff + 1);
-    cpu_write_to_bus(cpu->bus, address, value);
+    uint8_t value = cpu->x & cpu_read(cpu, (address >> 8) & 0xff + 1);
+    cpu_write(cpu, address, value);
 }
 
 /**
@@ -806,7 +945,7 @@ static inline void lax(State6502 *cpu, uint8_t value) {
  * @param address
  */
 static inline void las(State6502 *cpu, uint16_t address) {
-    uint8_t value = cpu_read_from_bus(cpu->bus, address) & cpu->sp;
+    uint8_t value = cpu_read(cpu, address) & cpu->sp;
     lda(cpu, value);
     ldx(cpu, value);
     cpu->sp = value;
@@ -837,10 +976,6 @@ static inline void isc(State6502 *cpu, uint16_t address) {
 /************************ EMULATION ************************/
 
 int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
-    if (cpu->debug) {
-        printf("%s\n", Disassemble6502Op(opcode, cpu->pc));
-    }
-
     switch (*opcode) {
         case 0x00:  // BRK imp
         {
@@ -848,7 +983,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
             uint8_t brk_sr = get_status_register(cpu) ^ 0x10;
             push(cpu, brk_sr);
             cpu->sr.i = 1;
-            cpu->pc = (cpu_read_from_bus(cpu->bus, 0xffff) << 8) | (cpu_read_from_bus(cpu->bus, 0xfffe));
+            cpu->pc = (cpu_read(cpu, 0xffff) << 8) | (cpu_read(cpu, 0xfffe));
 
             break;
         }
@@ -856,7 +991,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x01:  // or_a, (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            or_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            or_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -880,7 +1015,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x05:  // or_a, $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            or_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            or_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -932,7 +1067,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x0d:  // or_a, $oper $oper (absolute)
         {
             uint16_t address = (opcode[2] << 8) | (opcode[1]);
-            or_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            or_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -952,7 +1087,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
 
         case 0x10:  // BPL $oper (relative)
         {
-            if (cpu->sr.n == 0) {  // check if result was positive
+            if (!negative_flag(cpu)) {  // check if result was positive
                 branch(cpu, opcode[1]);
             }
             break;
@@ -961,7 +1096,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x11:  // or_a ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            or_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            or_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -985,7 +1120,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x15:  // or_a, $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            or_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            or_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1012,7 +1147,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x19:  // ORA Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            or_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            or_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1036,7 +1171,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x1d:  // or_a X, $oper $oper (absolute, x-indexed)
         {
             uint16_t address = absolute_x(cpu, opcode);
-            or_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            or_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1065,7 +1200,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x21:  // AND (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            and_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            and_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1084,14 +1219,14 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x24:  // BIT $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            bit(cpu, cpu_read_from_bus(cpu->bus, opcode[1]));
+            bit(cpu, cpu_read(cpu, opcode[1]));
             break;
         }
 
         case 0x25:  // AND $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            and_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            and_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1129,21 +1264,21 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
 
         case 0x2b:  // ANC #$oper (immediate)
         {
-            anc(cpu, cpu_read_from_bus(cpu->bus, opcode[1]));
+            anc(cpu, cpu_read(cpu, opcode[1]));
             break;
         }
 
         case 0x2c:  // BIT $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            bit(cpu, cpu_read_from_bus(cpu->bus, address));
+            bit(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0x2d:  // AND  $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            and_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            and_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1163,7 +1298,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
 
         case 0x30:  // BMI (relative)
         {
-            if (cpu->sr.n == 1)
+            if (negative_flag(cpu))
                 branch(cpu, opcode[1]);
             break;
         }
@@ -1171,7 +1306,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x31:  // AND ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            and_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            and_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1195,7 +1330,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x35:  // AND $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            and_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            and_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1222,7 +1357,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x39:  // AND Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            and_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            and_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1246,7 +1381,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x3d:  // AND X, $oper $oper (absolute, x-indexed)
         {
             uint16_t address = absolute_x(cpu, opcode);
-            and_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            and_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1274,7 +1409,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x41:  // EOR (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            xor_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            xor_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1286,7 +1421,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x43:  // SRE
         {
             uint8_t index = (opcode[1] + cpu->x) & 0xff;
-            uint16_t address = (cpu_read_from_bus(cpu->bus, (index + 1) & 0xff) << 8) | cpu_read_from_bus(cpu->bus, index);
+            uint16_t address = (cpu_read(cpu, (index + 1) & 0xff) << 8) | cpu_read(cpu, index);
             sre(cpu, address);
             break;
         }
@@ -1299,7 +1434,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x45:  // EOR $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            xor_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            xor_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1350,7 +1485,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x4d:  // EOR $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            xor_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            xor_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1378,7 +1513,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x51:  // EOR ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            xor_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            xor_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1402,7 +1537,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x55:  // EOR  $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            xor_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            xor_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1429,7 +1564,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x59:  // EOR Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            xor_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            xor_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1453,7 +1588,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x5d:  // EOR X, $oper, $oper (absolute, x-indexed)
         {
             uint16_t address = absolute_x(cpu, opcode);
-            xor_a(cpu, cpu_read_from_bus(cpu->bus, address));
+            xor_a(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1481,7 +1616,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x61:  // ADC (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            adc(cpu, cpu_read_from_bus(cpu->bus, address));
+            adc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1505,7 +1640,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x65:  // ADC $oper (zero-paged)
         {
             uint16_t address = zero_page(cpu, opcode);
-            adc(cpu, cpu_read_from_bus(cpu->bus, address));
+            adc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1551,10 +1686,10 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x6c:  // JMP ($oper $oper) (indirect)
         {
             uint16_t index = (opcode[2] << 8) | opcode[1];
-            uint16_t address = (cpu_read_from_bus(cpu->bus, (index + 1)) << 8) | cpu_read_from_bus(cpu->bus, index);
 
-            if ((index & 0xff) == 0xff)
-                address = (cpu_read_from_bus(cpu->bus, (uint16_t)(index & 0xff00)) << 8) | cpu_read_from_bus(cpu->bus, index);
+            // the high byte does not carry into the next page
+            uint16_t high = (index & 0xff) == 0xff ? index & 0xff00 : index + 1;
+            uint16_t address = (cpu_read(cpu, high) << 8) | cpu_read(cpu, index);
 
             jump(cpu, address);
             break;
@@ -1563,7 +1698,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x6d:  // ADC $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            adc(cpu, cpu_read_from_bus(cpu->bus, address));
+            adc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1591,7 +1726,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x71:  // ADC ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            adc(cpu, cpu_read_from_bus(cpu->bus, address));
+            adc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1615,7 +1750,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x75:  // ADC $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            adc(cpu, cpu_read_from_bus(cpu->bus, address));
+            adc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1642,7 +1777,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x79:  // ADC Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            adc(cpu, cpu_read_from_bus(cpu->bus, address));
+            adc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1666,7 +1801,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0x7d:  // ADC X, $oper $oper (absolute, x-indexed)
         {
             uint16_t address = absolute_x(cpu, opcode);
-            adc(cpu, cpu_read_from_bus(cpu->bus, address));
+            adc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1903,7 +2038,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xa1:  // LDA (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            lda(cpu, cpu_read_from_bus(cpu->bus, address));
+            lda(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -1916,35 +2051,35 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xa3:  // LAX (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            lax(cpu, cpu_read_from_bus(cpu->bus, address));
+            lax(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xa4:  // LDY $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            ldy(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldy(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xa5:  // LDA $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            lda(cpu, cpu_read_from_bus(cpu->bus, address));
+            lda(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xa6:  // LDX $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            ldx(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldx(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xa7:  // LAX $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            lax(cpu, cpu_read_from_bus(cpu->bus, address));
+            lax(cpu, cpu_read(cpu, address));
         }
 
         case 0xa8:  // TAY (implied)
@@ -1973,28 +2108,28 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xac:  // LDY $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            ldy(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldy(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xad:  // LDA $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            lda(cpu, cpu_read_from_bus(cpu->bus, address));
+            lda(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xae:  // LDX $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            ldx(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldx(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xaf:  // LAX $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            lax(cpu, cpu_read_from_bus(cpu->bus, address));
+            lax(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2008,7 +2143,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xb1:  // LDA ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            lda(cpu, cpu_read_from_bus(cpu->bus, address));
+            lda(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2020,21 +2155,21 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xb3:  // LAX ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            lax(cpu, cpu_read_from_bus(cpu->bus, address));
+            lax(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xb4:  // LDY $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            ldy(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldy(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xb5:  // LDA $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            lda(cpu, cpu_read_from_bus(cpu->bus, address));
+            lda(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2049,7 +2184,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
             // address = (cpu->x + opcode[1]) & 0xff;
 
             // printf("address = %d\n", address);
-            ldx(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldx(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2064,7 +2199,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
             // address = (cpu->x + opcode[1]) & 0xff;
 
             // printf("address = %d\n", address);
-            lax(cpu, cpu_read_from_bus(cpu->bus, address));
+            lax(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2077,7 +2212,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xb9:  // LDA Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            lda(cpu, cpu_read_from_bus(cpu->bus, address));
+            lda(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2097,7 +2232,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xbc:  // LDY X, $oper $oper (absolute, x-indexed)
         {
             uint16_t address = absolute_x(cpu, opcode);
-            ldy(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldy(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2105,21 +2240,21 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         {
             uint16_t address = absolute_x(cpu, opcode);
             // printf("ADDRESS = $%04x\n", address);
-            lda(cpu, cpu_read_from_bus(cpu->bus, address));
+            lda(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xbe:  // LDX Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            ldx(cpu, cpu_read_from_bus(cpu->bus, address));
+            ldx(cpu, cpu_read(cpu, address));
             break;
         }
 
         case 0xbf:  // LAX Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            lax(cpu, cpu_read_from_bus(cpu->bus, address));
+            lax(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2132,7 +2267,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xc1:  // CMP (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            cmp(cpu, cpu->a, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->a, cpu_read(cpu, address));
             break;
         }
 
@@ -2151,14 +2286,14 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xc4:  // CPY $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            cmp(cpu, cpu->y, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->y, cpu_read(cpu, address));
             break;
         }
 
         case 0xc5:  // CMP $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            cmp(cpu, cpu->a, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->a, cpu_read(cpu, address));
             break;
         }
 
@@ -2204,14 +2339,14 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xcc:  // CPY $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            cmp(cpu, cpu->y, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->y, cpu_read(cpu, address));
             break;
         }
 
         case 0xcd:  // CMP $oper $oper (absolute)
         {
             uint16_t address = absolute(cpu, opcode);
-            cmp(cpu, cpu->a, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->a, cpu_read(cpu, address));
             break;
         }
 
@@ -2231,7 +2366,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
 
         case 0xd0:  // BNE (relative)
         {
-            if (cpu->sr.z == 0)
+            if (!zero_flag(cpu))
                 branch(cpu, opcode[1]);
             break;
         }
@@ -2239,7 +2374,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xd1:  // CMP ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            cmp(cpu, cpu->a, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->a, cpu_read(cpu, address));
             break;
         }
 
@@ -2263,7 +2398,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xd5:  // CMP $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            cmp(cpu, cpu->a, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->a, cpu_read(cpu, address));
             break;
         }
 
@@ -2290,7 +2425,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xd9:  // CMP Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            cmp(cpu, cpu->a, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->a, cpu_read(cpu, address));
             break;
         }
 
@@ -2314,7 +2449,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xdd:  // CMP X, $oper $oper (absolute, x-indexed)
         {
             uint16_t address = absolute_x(cpu, opcode);
-            cmp(cpu, cpu->a, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->a, cpu_read(cpu, address));
             break;
         }
 
@@ -2341,7 +2476,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xe1:  // SBC (X, $oper) (X-indexed, indirect)
         {
             uint16_t address = x_indexed_indirect(cpu, opcode);
-            sbc(cpu, cpu_read_from_bus(cpu->bus, address));
+            sbc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2360,14 +2495,14 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xe4:  // CPX $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            cmp(cpu, cpu->x, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->x, cpu_read(cpu, address));
             break;
         }
 
         case 0xe5:  // SBC $oper (zero-page)
         {
             uint16_t address = zero_page(cpu, opcode);
-            sbc(cpu, cpu_read_from_bus(cpu->bus, address));
+            sbc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2410,14 +2545,14 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xec:  // CPX $oper $oper (absolute)
         {
             uint16_t address = (opcode[2] << 8) | opcode[1];
-            cmp(cpu, cpu->x, cpu_read_from_bus(cpu->bus, address));
+            cmp(cpu, cpu->x, cpu_read(cpu, address));
             break;
         }
 
         case 0xed:  // SBC $oper $oper (absolute)
         {
             uint16_t address = (opcode[2] << 8) | opcode[1];
-            sbc(cpu, cpu_read_from_bus(cpu->bus, address));
+            sbc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2437,7 +2572,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
 
         case 0xf0:  // BEQ $oper (relative)
         {
-            if (cpu->sr.z == 1)
+            if (zero_flag(cpu))
                 branch(cpu, opcode[1]);
             break;
         }
@@ -2445,7 +2580,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xf1:  // SBC ($oper), Y (indirect, Y-indexed)
         {
             uint16_t address = indirect_y_indexed(cpu, opcode);
-            sbc(cpu, cpu_read_from_bus(cpu->bus, address));
+            sbc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2469,7 +2604,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xf5:  // SBC $oper, X (zero-page, x-indexed)
         {
             uint16_t address = zero_page_x(cpu, opcode);
-            sbc(cpu, cpu_read_from_bus(cpu->bus, address));
+            sbc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2496,7 +2631,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xf9:  // SBC Y, $oper $oper (absolute, y-indexed)
         {
             uint16_t address = absolute_y(cpu, opcode);
-            sbc(cpu, cpu_read_from_bus(cpu->bus, address));
+            sbc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2520,7 +2655,7 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         case 0xfd:  // SBC X, $oper $oper (absolute, x-indexed)
         {
             uint16_t address = absolute_x(cpu, opcode);
-            sbc(cpu, cpu_read_from_bus(cpu->bus, address));
+            sbc(cpu, cpu_read(cpu, address));
             break;
         }
 
@@ -2544,30 +2679,589 @@ int emulate6502Op(State6502 *cpu, uint8_t *opcode) {
         }
     }
 
-    /* print out processor cpu */
-    if (cpu->debug) {
-        printf("\tN=%d,V=%d,B=%d,D=%d,I=%d,Z=%d,C=%d\n", cpu->sr.n, cpu->sr.v,
-               cpu->sr.b, cpu->sr.d, cpu->sr.i, cpu->sr.z, cpu->sr.c);
-        printf("\tA $%02x X $%02x Y $%02x SP %04x PC %04x\n", cpu->a, cpu->x,
-               cpu->y, cpu->sp, cpu->pc);
+    return 0;
+}
+
+/************************ TRACE ************************/
+
+/**
+ * @brief the cpu state a trace records for the instruction at pc, before it runs
+ *
+ * @param cpu
+ * @param opcode the instruction's bytes
+ * @param cycle ppu cycle the instruction starts on
+ * @param entry
+ */
+static void get_trace_entry(State6502 *cpu, uint8_t *opcode, uint64_t cycle, TraceEntry *entry) {
+    Bus *bus = cpu->bus;
+
+    entry->pc = cpu->pc;
+    entry->opcode[0] = opcode[0];
+    entry->opcode[1] = opcode[1];
+    entry->opcode[2] = opcode[2];
+    entry->a = cpu->a;
+    entry->x = cpu->x;
+    entry->y = cpu->y;
+    entry->p = get_status_register(cpu);
+    entry->sp = cpu->sp;
+    entry->cycle = cycle / 3;
+
+    // the ppu only runs when something needs it, so work out where it is at the start of the instruction
+    int scanline;
+    int dot;
+    ppu_position_after(bus->ppu, cycle > bus->system_cycles ? cycle - bus->system_cycles : 0, &scanline, &dot);
+    entry->scanline = scanline;
+    entry->dot = dot;
+    entry->memory = false;
+}
+
+/**
+ * @brief read memory for a trace line without side effects, registers read as $FF as they do in nestest logs
+ *
+ * @param context the bus
+ * @param address
+ * @return uint8_t
+ */
+static uint8_t peek_trace_memory(void *context, uint16_t address) {
+    uint8_t *page = ((Bus *)context)->cpu_read_pages[address >> 8];
+    return page ? page[address & 0xff] : 0xff;
+}
+
+/**
+ * @brief add the instruction about to run to the cpu's trace (stdout if it has none)
+ *
+ * @param cpu
+ * @param opcode
+ * @param cycle ppu cycle the instruction started on
+ */
+static void trace_instruction(State6502 *cpu, uint8_t *opcode, uint64_t cycle) {
+    TraceEntry entry;
+    get_trace_entry(cpu, opcode, cycle, &entry);
+
+    if (cpu->trace && cpu->trace->binary) {
+        uint8_t record[TRACE_RECORD_SIZE];
+        pack_trace_entry(&entry, record);
+        write_trace_record(cpu->trace, record);
+        return;
     }
 
-    return 0;
+    read_trace_memory(&entry, peek_trace_memory, cpu->bus);
+
+    char line[TRACE_LINE_LENGTH];
+    int length = format_trace_entry(&entry, line, sizeof(line));
+    if (length > (int)sizeof(line) - 1)
+        length = sizeof(line) - 1;
+
+    if (cpu->trace)
+        write_trace_line(cpu->trace, line, length);
+    else
+        fwrite(line, 1, length, stdout);
+}
+
+/************************ HANDLER TABLE ************************/
+// the same instructions as emulate6502Op, one function per opcode built from the helpers above
+
+typedef void (*OpcodeHandler)(State6502 *cpu, uint8_t *opcode);
+typedef uint16_t (*AddressingMode)(State6502 *cpu, uint8_t *opcode);
+
+static inline void cmp_a(State6502 *cpu, uint8_t value) {
+    cmp(cpu, cpu->a, value);
+}
+
+static inline void cmp_x(State6502 *cpu, uint8_t value) {
+    cmp(cpu, cpu->x, value);
+}
+
+static inline void cmp_y(State6502 *cpu, uint8_t value) {
+    cmp(cpu, cpu->y, value);
+}
+
+static void nop(State6502 *cpu, uint8_t *opcode) {
+}
+
+template <void (*OPERATION)(State6502 *)>
+static void implied_op(State6502 *cpu, uint8_t *opcode) {
+    OPERATION(cpu);
+}
+
+template <void (*OPERATION)(State6502 *, uint8_t)>
+static void immediate_op(State6502 *cpu, uint8_t *opcode) {
+    OPERATION(cpu, opcode[1]);
+}
+
+// operations on the value at the effective address
+template <void (*OPERATION)(State6502 *, uint8_t), AddressingMode MODE>
+static void read_op(State6502 *cpu, uint8_t *opcode) {
+    uint16_t address = MODE(cpu, opcode);
+    OPERATION(cpu, cpu_read(cpu, address));
+}
+
+// stores, read-modify-write and jumps, which take the effective address itself
+template <void (*OPERATION)(State6502 *, uint16_t), AddressingMode MODE>
+static void address_op(State6502 *cpu, uint8_t *opcode) {
+    OPERATION(cpu, MODE(cpu, opcode));
+}
+
+template <bool (*FLAG)(State6502 *), bool TAKEN>
+static void branch_op(State6502 *cpu, uint8_t *opcode) {
+    if (FLAG(cpu) == TAKEN)
+        branch(cpu, opcode[1]);
+}
+
+template <bool StatusRegister::*FLAG, bool VALUE>
+static void flag_op(State6502 *cpu, uint8_t *opcode) {
+    cpu->sr.*FLAG = VALUE;
+}
+
+// a few cases in emulate6502Op have no break and run the next case too, the table keeps that behaviour
+template <OpcodeHandler FIRST, OpcodeHandler SECOND>
+static void fall_through(State6502 *cpu, uint8_t *opcode) {
+    FIRST(cpu, opcode);
+    SECOND(cpu, opcode);
+}
+
+static void brk(State6502 *cpu, uint8_t *opcode) {
+    push_16(cpu, cpu->pc + 2);
+    push(cpu, get_status_register(cpu) ^ 0x10);
+    cpu->sr.i = 1;
+    cpu->pc = (cpu_read(cpu, 0xffff) << 8) | (cpu_read(cpu, 0xfffe));
+}
+
+static void jsr(State6502 *cpu, uint8_t *opcode) {
+    push_16(cpu, cpu->pc + 2);
+    cpu->pc = absolute(cpu, opcode);
+}
+
+static void rti(State6502 *cpu, uint8_t *opcode) {
+    set_status_register(cpu, pop(cpu));
+    cpu->pc = pop_16(cpu);
+}
+
+static void rts(State6502 *cpu, uint8_t *opcode) {
+    cpu->pc = pop_16(cpu);
+}
+
+static void jmp_indirect(State6502 *cpu, uint8_t *opcode) {
+    uint16_t index = (opcode[2] << 8) | opcode[1];
+
+    // the high byte does not carry into the next page
+    uint16_t high = (index & 0xff) == 0xff ? index & 0xff00 : index + 1;
+    jump(cpu, (cpu_read(cpu, high) << 8) | cpu_read(cpu, index));
+}
+
+static void php(State6502 *cpu, uint8_t *opcode) {
+    push(cpu, get_status_register(cpu) ^ 0x10);
+}
+
+static void plp(State6502 *cpu, uint8_t *opcode) {
+    set_status_register(cpu, pop(cpu));
+}
+
+static void pha(State6502 *cpu, uint8_t *opcode) {
+    push(cpu, cpu->a);
+}
+
+static void pla(State6502 *cpu, uint8_t *opcode) {
+    cpu->a = pop(cpu);
+    update_zn(cpu, cpu->a);
+}
+
+#define ZP zero_page
+#define ZPX zero_page_x
+#define ZPY zero_page_y
+#define ABS absolute
+#define ABX absolute_x
+#define ABY absolute_y
+#define IZX x_indexed_indirect
+#define IZY indirect_y_indexed
+
+static const OpcodeHandler OPCODE_HANDLERS[256] = {
+    // 0x00
+    brk, read_op<or_a, IZX>, nop, address_op<slo, IZX>,
+    nop, read_op<or_a, ZP>, address_op<asl_memory, ZP>, address_op<slo, ZP>,
+    php, immediate_op<or_a>, implied_op<asl_a>, immediate_op<anc>,
+    nop, read_op<or_a, ABS>, address_op<asl_memory, ABS>, address_op<slo, ABS>,
+
+    // 0x10
+    branch_op<negative_flag, false>, read_op<or_a, IZY>, nop, address_op<slo, IZY>,
+    nop, read_op<or_a, ZPX>, address_op<asl_memory, ZPX>, address_op<slo, ZPX>,
+    flag_op<&StatusRegister::c, false>, read_op<or_a, ABY>, nop, address_op<slo, ABY>,
+    nop, read_op<or_a, ABX>, address_op<asl_memory, ABX>, address_op<slo, ABX>,
+
+    // 0x20 (ANC $2b reads its operand from the zero page)
+    jsr, read_op<and_a, IZX>, nop, address_op<rla, IZX>,
+    read_op<bit, ZP>, read_op<and_a, ZP>, address_op<rol_memory, ZP>, address_op<rla, ZP>,
+    plp, immediate_op<and_a>, implied_op<rol_a>, read_op<anc, ZP>,
+    read_op<bit, ABS>, read_op<and_a, ABS>, address_op<rol_memory, ABS>, address_op<rla, ABS>,
+
+    // 0x30
+    branch_op<negative_flag, true>, read_op<and_a, IZY>, nop, address_op<rla, IZY>,
+    nop, read_op<and_a, ZPX>, address_op<rol_memory, ZPX>, address_op<rla, ZPX>,
+    flag_op<&StatusRegister::c, true>, read_op<and_a, ABY>, nop, address_op<rla, ABY>,
+    nop, read_op<and_a, ABX>, address_op<rol_memory, ABX>, address_op<rla, ABX>,
+
+    // 0x40
+    rti, read_op<xor_a, IZX>, nop, address_op<sre, IZX>,
+    nop, read_op<xor_a, ZP>, address_op<lsr_memory, ZP>, fall_through<address_op<sre, ZP>, pha>,
+    pha, immediate_op<xor_a>, implied_op<lsr_a>, immediate_op<alr>,
+    address_op<jump, ABS>, read_op<xor_a, ABS>, address_op<lsr_memory, ABS>, address_op<sre, ABS>,
+
+    // 0x50
+    branch_op<overflow_flag, false>, read_op<xor_a, IZY>, nop, address_op<sre, IZY>,
+    nop, read_op<xor_a, ZPX>, address_op<lsr_memory, ZPX>, address_op<sre, ZPX>,
+    flag_op<&StatusRegister::i, false>, read_op<xor_a, ABY>, nop, address_op<sre, ABY>,
+    nop, read_op<xor_a, ABX>, address_op<lsr_memory, ABX>, address_op<sre, ABX>,
+
+    // 0x60
+    rts, read_op<adc, IZX>, nop, address_op<rra, IZX>,
+    nop, read_op<adc, ZP>, address_op<ror_memory, ZP>, address_op<rra, ZP>,
+    pla, immediate_op<adc>, implied_op<ror_a>, immediate_op<arr>,
+    jmp_indirect, read_op<adc, ABS>, address_op<ror_memory, ABS>, address_op<rra, ABS>,
+
+    // 0x70
+    branch_op<overflow_flag, true>, read_op<adc, IZY>, nop, address_op<rra, IZY>,
+    nop, read_op<adc, ZPX>, address_op<ror_memory, ZPX>, address_op<rra, ZPX>,
+    flag_op<&StatusRegister::i, true>, read_op<adc, ABY>, nop, address_op<rra, ABY>,
+    nop, read_op<adc, ABX>, address_op<ror_memory, ABX>, address_op<rra, ABX>,
+
+    // 0x80
+    nop, address_op<sta, IZX>, nop, address_op<sax, IZX>,
+    address_op<sty, ZP>, address_op<sta, ZP>, address_op<stx, ZP>, address_op<sax, ZP>,
+    implied_op<dey>, nop, implied_op<txa>, fall_through<immediate_op<ane>, address_op<sty, ABS>>,
+    address_op<sty, ABS>, address_op<sta, ABS>, address_op<stx, ABS>, address_op<sax, ABS>,
+
+    // 0x90 (SHY $9c is handled as STA)
+    branch_op<carry_flag, false>, address_op<sta, IZY>, nop, address_op<sha, IZY>,
+    address_op<sty, ZPX>, address_op<sta, ZPX>, address_op<stx, ZPY>, address_op<sax, ZPY>,
+    implied_op<tya>, address_op<sta, ABY>, implied_op<txs>, address_op<tas, ABY>,
+    address_op<sta, ABX>, address_op<sta, ABX>, address_op<shx, ABY>, address_op<sha, ABY>,
+
+    // 0xa0
+    immediate_op<ldy>, read_op<lda, IZX>, immediate_op<ldx>, read_op<lax, IZX>,
+    read_op<ldy, ZP>, read_op<lda, ZP>, read_op<ldx, ZP>, fall_through<read_op<lax, ZP>, implied_op<tay>>,
+    implied_op<tay>, immediate_op<lda>, implied_op<tax>, fall_through<immediate_op<lax>, read_op<ldy, ABS>>,
+    read_op<ldy, ABS>, read_op<lda, ABS>, read_op<ldx, ABS>, read_op<lax, ABS>,
+
+    // 0xb0
+    branch_op<carry_flag, true>, read_op<lda, IZY>, nop, read_op<lax, IZY>,
+    read_op<ldy, ZPX>, read_op<lda, ZPX>, read_op<ldx, ZPY>, read_op<lax, ZPY>,
+    flag_op<&StatusRegister::v, false>, read_op<lda, ABY>, implied_op<tsx>, address_op<las, ABY>,
+    read_op<ldy, ABX>, read_op<lda, ABX>, read_op<ldx, ABY>, read_op<lax, ABY>,
+
+    // 0xc0
+    immediate_op<cmp_y>, read_op<cmp_a, IZX>, nop, address_op<dcp, IZX>,
+    read_op<cmp_y, ZP>, read_op<cmp_a, ZP>, address_op<dec, ZP>, address_op<dcp, ZP>,
+    implied_op<iny>, immediate_op<cmp_a>, implied_op<dex>, address_op<dcp, ABY>,
+    read_op<cmp_y, ABS>, read_op<cmp_a, ABS>, address_op<dec, ABS>, address_op<dcp, ABS>,
+
+    // 0xd0
+    branch_op<zero_flag, false>, read_op<cmp_a, IZY>, nop, address_op<dcp, IZY>,
+    nop, read_op<cmp_a, ZPX>, address_op<dec, ZPX>, address_op<dcp, ZPX>,
+    flag_op<&StatusRegister::d, false>, read_op<cmp_a, ABY>, nop, address_op<dcp, ABY>,
+    nop, read_op<cmp_a, ABX>, address_op<dec, ABX>, address_op<dcp, ABX>,
+
+    // 0xe0
+    immediate_op<cmp_x>, read_op<sbc, IZX>, nop, address_op<isc, IZX>,
+    read_op<cmp_x, ZP>, read_op<sbc, ZP>, address_op<inc, ZP>, address_op<isc, ZP>,
+    implied_op<inx>, immediate_op<sbc>, nop, fall_through<immediate_op<sbc>, read_op<cmp_x, ABS>>,
+    read_op<cmp_x, ABS>, read_op<sbc, ABS>, address_op<inc, ABS>, address_op<isc, ABS>,
+
+    // 0xf0
+    branch_op<zero_flag, true>, read_op<sbc, IZY>, nop, address_op<isc, IZY>,
+    nop, read_op<sbc, ZPX>, address_op<inc, ZPX>, address_op<isc, ZPX>,
+    flag_op<&StatusRegister::d, true>, read_op<sbc, ABY>, nop, address_op<isc, ABY>,
+    nop, read_op<sbc, ABX>, address_op<inc, ABX>, address_op<isc, ABX>,
+};
+
+#undef ZP
+#undef ZPX
+#undef ZPY
+#undef ABS
+#undef ABX
+#undef ABY
+#undef IZX
+#undef IZY
+
+/**
+ * @brief whether the instruction has a 16-bit operand. OPCODES_BYTES is 0 for the jumps,
+ * since they set pc themselves
+ *
+ * @param opcode
+ * @return bool
+ */
+static inline bool has_absolute_operand(uint8_t opcode) {
+    return OPCODES_BYTES[opcode] == 3 || opcode == 0x20 || opcode == 0x4c || opcode == 0x6c;
 }
 
 /**
- * @brief perform one cpu clock cycle, update bytes and cycles
+ * @brief how many bytes fetch_opcode reads through cpu_read for an instruction, for the read counters
+ *
+ * @param opcode
+ * @return uint8_t
+ */
+static inline uint8_t fetched_bytes(uint8_t opcode) {
+    if (has_absolute_operand(opcode))
+        return 3;
+    return OPCODES_BYTES[opcode] == 1 ? 1 : 2;
+}
+
+/**
+ * @brief read the opcode and its operand bytes. the 6502 always reads the byte after the opcode,
+ * the third is only read for 16-bit operands. operand bytes that aren't fetched are 0
  *
  * @param cpu
+ * @param opcode
  */
-void clock_cpu(State6502 *cpu) {
-    if (cpu->cycles == 0) {
-        uint8_t opcode[3] = {cpu_read_from_bus(cpu->bus, cpu->pc), cpu_read_from_bus(cpu->bus, cpu->pc + 1), cpu_read_from_bus(cpu->bus, cpu->pc + 2)};
+static inline void fetch_opcode(State6502 *cpu, uint8_t *opcode) {
+    Bus *bus = cpu->bus;
+    uint8_t *page = bus->cpu_read_pages[cpu->pc >> 8];
+    uint8_t offset = cpu->pc & 0xff;
+
+    // code runs from rom or ram, so the whole instruction can nearly always be copied straight from its page
+    if (page && offset <= 0xfd) {
+        opcode[0] = page[offset];
+        opcode[1] = page[offset + 1];
+        opcode[2] = page[offset + 2];
+        bus->cpu_clock += has_absolute_operand(opcode[0]) ? 9 : 6;
+        COUNT_BY(cpu_reads[cpu->pc >> 13], fetched_bytes(opcode[0]));
+        return;
+    }
 
-        emulate6502Op(cpu, opcode);
+    opcode[0] = cpu_read(cpu, cpu->pc);
 
-        cpu->cycles = OPCODES_CYCLES[opcode[0]];
-        cpu->pc += OPCODES_BYTES[opcode[0]];
+    if (OPCODES_BYTES[opcode[0]] == 1) {
+        opcode[1] = 0;
+        bus->cpu_clock += 3;
     }
-    cpu->cycles--;
-}
\ No newline at end of file
+    else {
+        opcode[1] = cpu_read(cpu, cpu->pc + 1);
+    }
+
+    opcode[2] = has_absolute_operand(opcode[0]) ? cpu_read(cpu, cpu->pc + 2) : 0;
+}
+
+/**
+ * @brief run one instruction through emulate6502Op
+ *
+ * @param cpu
+ * @return uint32_t
+ */
+uint32_t step_cpu_switch(State6502 *cpu) {
+    uint64_t start = cpu->bus->cpu_clock;
+    uint8_t opcode[3];
+    fetch_opcode(cpu, opcode);
+
+    if (cpu->debug)
+        trace_instruction(cpu, opcode, start);
+
+    emulate6502Op(cpu, opcode);
+    cpu->instructions++;
+    COUNT(opcodes[opcode[0]]);
+
+    cpu->pc += OPCODES_BYTES[opcode[0]];
+    return OPCODES_CYCLES[opcode[0]];
+}
+
+/**
+ * @brief run one instruction through the handler table
+ *
+ * @param cpu
+ * @return uint32_t
+ */
+uint32_t step_cpu_table(State6502 *cpu) {
+    uint64_t start = cpu->bus->cpu_clock;
+    uint8_t opcode[3];
+    fetch_opcode(cpu, opcode);
+
+    if (__builtin_expect(cpu->debug, 0))
+        trace_instruction(cpu, opcode, start);
+
+    OPCODE_HANDLERS[opcode[0]](cpu, opcode);
+    cpu->instructions++;
+    COUNT(opcodes[opcode[0]]);
+
+    cpu->pc += OPCODES_BYTES[opcode[0]];
+    return OPCODES_CYCLES[opcode[0]];
+}
+
+/**
+ * @brief run one whole instruction with the core chosen at build time
+ *
+ * @param cpu
+ * @return uint32_t
+ */
+uint32_t step_cpu(State6502 *cpu) {
+#ifdef CPU_SWITCH_CORE
+    return step_cpu_switch(cpu);
+#else
+    return step_cpu_table(cpu);
+#endif
+}
+
+/************************ BLOCK CACHE ************************/
+
+void enable_block_cache(State6502 *cpu, uint8_t *prg_rom, uint32_t prg_rom_size) {
+    BlockCache *cache = (BlockCache *)malloc(sizeof(BlockCache));
+
+    cache->prg_rom = prg_rom;
+    cache->prg_rom_size = prg_rom_size;
+    cache->ops = (DecodedOp *)calloc(prg_rom_size, sizeof(DecodedOp));
+    cache->instructions = 0;
+
+    cpu->block_cache = cache;
+}
+
+/**
+ * @brief decode the instruction at a prg rom offset, with the operand bytes fetch_opcode would give
+ *
+ * @param cache
+ * @param offset
+ */
+static void decode_op(BlockCache *cache, uint32_t offset) {
+    DecodedOp *op = &cache->ops[offset];
+    uint8_t *code = &cache->prg_rom[offset];
+    uint16_t window_offset = offset & 0x1fff;
+
+    op->handler = OPCODE_HANDLERS[code[0]];
+    op->opcode[0] = code[0];
+    op->uncached = window_offset > 0x1ffd;
+    if (op->uncached)
+        return;
+
+    if ((offset & 0xff) <= 0xfd) {
+        op->opcode[1] = code[1];
+        op->opcode[2] = code[2];
+    }
+
+    else {
+        op->opcode[1] = OPCODES_BYTES[code[0]] == 1 ? 0 : code[1];
+        op->opcode[2] = has_absolute_operand(code[0]) ? code[2] : 0;
+    }
+
+    op->fetch_clock = has_absolute_operand(code[0]) ? 9 : 6;
+    op->bytes = OPCODES_BYTES[code[0]];
+    op->cycles = OPCODES_CYCLES[code[0]];
+
+    // BRK, JSR, RTI, RTS, JMP and the branches are the only instructions that move pc themselves
+    bool branch = (code[0] & 0x1f) == 0x10;
+    bool jump = code[0] == 0x00 || code[0] == 0x20 || code[0] == 0x40 || code[0] == 0x60 || code[0] == 0x4c ||
+                code[0] == 0x6c;
+    op->ends_block = branch || jump || window_offset + op->bytes > 0x1fff;
+}
+
+DecodedOp *lookup_block(State6502 *cpu) {
+    BlockCache *cache = cpu->block_cache;
+    if (cpu->pc < 0x8000)
+        return NULL;
+
+    uint8_t *code = &cpu->bus->prg_windows[(cpu->pc >> 13) & 0x3][cpu->pc & 0x1fff];
+    if (code < cache->prg_rom || code >= cache->prg_rom + cache->prg_rom_size)
+        return NULL;
+
+    uint32_t offset = code - cache->prg_rom;
+    DecodedOp *op = &cache->ops[offset];
+    if (!op->handler)
+        decode_op(cache, offset);
+
+    return op->uncached ? NULL : op;
+}
+
+uint32_t step_decoded(State6502 *cpu, DecodedOp *op) {
+    cpu->bus->cpu_clock += op->fetch_clock;
+    COUNT_BY(cpu_reads[cpu->pc >> 13], fetched_bytes(op->opcode[0]));
+
+    op->handler(cpu, op->opcode);
+    cpu->instructions++;
+    cpu->block_cache->instructions++;
+    COUNT(opcodes[op->opcode[0]]);
+
+    cpu->pc += op->bytes;
+    return op->cycles;
+}
+
+/************************ IDLE LOOPS ************************/
+
+void enable_idle_loop_skip(State6502 *cpu) {
+    IdleLoop *loop = (IdleLoop *)calloc(1, sizeof(IdleLoop));
+    cpu->idle_loop = loop;
+}
+
+/**
+ * @brief whether an instruction only reads memory into registers or flags, in a way that gives the same
+ * result when it is repeated (LDA, LDX, LDY, CMP, CPX, CPY, BIT, AND, ORA and NOP, without indexing)
+ *
+ * @param opcode
+ * @return bool
+ */
+static bool is_idempotent_read(uint8_t opcode) {
+    switch (opcode) {
+        case 0xa9: case 0xa5: case 0xad:  // LDA
+        case 0xa2: case 0xa6: case 0xae:  // LDX
+        case 0xa0: case 0xa4: case 0xac:  // LDY
+        case 0xc9: case 0xc5: case 0xcd:  // CMP
+        case 0xe0: case 0xe4: case 0xec:  // CPX
+        case 0xc0: case 0xc4: case 0xcc:  // CPY
+        case 0x24: case 0x2c:             // BIT
+        case 0x29: case 0x25: case 0x2d:  // AND
+        case 0x09: case 0x05: case 0x0d:  // ORA
+        case 0xea:                        // NOP
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool find_idle_loop(State6502 *cpu, uint16_t pc, IdleLoop *loop) {
+    Bus *bus = cpu->bus;
+
+    loop->pc = pc;
+    loop->instructions = 0;
+    loop->cycles = 0;
+    loop->polls_ppu_status = false;
+
+    uint16_t address = pc;
+    for (int count = 1; count <= 8; count++) {
+        // the loop has to be in memory that can be read without side effects
+        uint8_t code[3];
+        for (int i = 0; i < 3; i++) {
+            uint8_t *page = bus->cpu_read_pages[(uint16_t)(address + i) >> 8];
+            if (!page)
+                return false;
+            code[i] = page[(address + i) & 0xff];
+        }
+
+        uint8_t opcode = code[0];
+        loop->cycles += OPCODES_CYCLES[opcode];
+
+        if ((opcode & 0x1f) == 0x10) {
+            // a branch back to the start, which can only stop being taken when something else changes memory
+            uint16_t target = address + 2 + (int8_t)code[1];
+            if (target != pc)
+                return false;
+
+            // taken, and maybe onto another page
+            loop->cycles += ((target ^ (address + 2)) & 0xff00) ? 2 : 1;
+
+            loop->instructions = count;
+            return true;
+        }
+
+        if (!is_idempotent_read(opcode))
+            return false;
+
+        // zero page and immediate operands are always ram or constants
+        if (OPCODES_BYTES[opcode] == 3) {
+            uint16_t operand = (code[2] << 8) | code[1];
+            if ((operand & 0xe007) == 0x2002)
+                loop->polls_ppu_status = true;
+            else if (!bus->cpu_read_pages[operand >> 8])
+                return false;
+        }
+
+        address += OPCODES_BYTES[opcode];
+    }
+
+    return false;
+}
+
@@ -50,16 +50,45 @@ static const uint8_t OPCODES_BYTES[256] = {
 
 
 typedef struct StatusRegister {
-    bool n;  // bit 7, 1 = negative
+    uint16_t nz;  // bits 7 and 1 (negative, zero), kept as the last result: n = bit 7 or 8 set, z = low byte 0
     bool v;  // bit 6, 1 = overflow
     bool b;  // bit 4, 1 = BRK, 0 = IRQB
     bool d;  // bit 3, 1 = decimal mode
     bool i;  // bit 2, 1 = IRQB disable
-    bool z;  // bit 1, 1 = zero
     bool c;  // bit 0, 1 = carry
 
 } StatusRegister;
 
+// ROM code decoded once, so instructions run without a fetch and a table lookup
+typedef struct DecodedOp {
+    void (*handler)(struct State6502 *cpu, uint8_t *opcode);  // NULL until decoded
+    uint8_t opcode[3];
+    uint8_t fetch_clock;  // ppu cycles taken by the opcode fetch
+    uint8_t bytes;        // OPCODES_BYTES
+    uint8_t cycles;       // OPCODES_CYCLES
+    bool ends_block;      // may change pc, or the next instruction is outside the 8K window
+    bool uncached;        // runs into the next 8K window, so it always goes through step_cpu
+} DecodedOp;
+
+typedef struct BlockCache {
+    uint8_t *prg_rom;       // ops are kept per prg rom offset, so a bank switch needs no invalidation
+    uint32_t prg_rom_size;
+    DecodedOp *ops;         // one per prg rom byte, straight-line code is consecutive instructions
+    uint64_t instructions;  // instructions run from the cache
+} BlockCache;
+
+// a short loop that only reads memory, so every pass after the first leaves the cpu in the same state
+// until something outside the cpu changes what it reads (see find_idle_loop)
+typedef struct IdleLoop {
+    uint16_t pc;                 // first instruction of the loop
+    uint8_t instructions;        // instructions in one pass, 0 if the code at pc is not an idle loop
+    uint32_t cycles;             // cpu cycles of one pass
+    bool polls_ppu_status;       // reads $2002, so sprite 0 hit and sprite overflow can end it too
+    uint64_t pass_clock;         // cpu_clock the last time pc was reached
+    uint64_t pass_instructions;  // instructions run the last time pc was reached
+    uint64_t skipped_cycles;     // cpu cycles fast forwarded so far
+} IdleLoop;
+
 typedef struct State6502 {
     uint8_t a;
     uint8_t x;
@@ -72,9 +101,13 @@ typedef struct State6502 {
 
     uint8_t int_enable;
     uint8_t halted;
-    uint16_t cycles;
+    uint16_t cycles;        // length in cycles of the interrupt sequences taken before the next instruction
+    uint64_t instructions;
 
     struct Bus *bus;
+    BlockCache *block_cache;  // NULL unless enable_block_cache was called
+    IdleLoop *idle_loop;      // NULL unless enable_idle_loop_skip was called
+    struct Trace *trace;      // where debug lines go, stdout when NULL
 
     bool debug;
     
@@ -602,8 +635,70 @@ static inline void isc(State6502 *cpu, uint16_t address);
 int emulate6502Op(State6502 *cpu, uint8_t *opcode);
 
 /**
- * @brief perform one cpu clock cycle
- * 
- * @param cpu 
+ * @brief run one whole instruction. uses the handler table core, or the switch core
+ * when built with -DCPU_SWITCH_CORE
+ *
+ * @param cpu
+ * @return uint32_t number of cpu cycles the instruction takes
+ */
+uint32_t step_cpu(State6502 *cpu);
+
+/**
+ * @brief run one whole instruction through the emulate6502Op switch
+ *
+ * @param cpu
+ * @return uint32_t number of cpu cycles the instruction takes
+ */
+uint32_t step_cpu_switch(State6502 *cpu);
+
+/**
+ * @brief run one whole instruction through the opcode handler table
+ *
+ * @param cpu
+ * @return uint32_t number of cpu cycles the instruction takes
+ */
+uint32_t step_cpu_table(State6502 *cpu);
+
+/**
+ * @brief decode and run rom code through the block cache from now on (see clock_bus)
+ *
+ * @param cpu
+ * @param prg_rom
+ * @param prg_rom_size
+ */
+void enable_block_cache(State6502 *cpu, uint8_t *prg_rom, uint32_t prg_rom_size);
+
+/**
+ * @brief decoded instruction at pc, decoding it first if needed
+ *
+ * @param cpu
+ * @return DecodedOp* NULL if pc is not in prg rom or the instruction can't be cached
+ */
+DecodedOp *lookup_block(State6502 *cpu);
+
+/**
+ * @brief run one decoded instruction, the same as step_cpu would
+ *
+ * @param cpu
+ * @param op
+ * @return uint32_t number of cpu cycles the instruction takes
+ */
+uint32_t step_decoded(State6502 *cpu, DecodedOp *op);
+
+/**
+ * @brief fast forward through idle loops from now on (see clock_bus)
+ *
+ * @param cpu
+ */
+void enable_idle_loop_skip(State6502 *cpu);
+
+/**
+ * @brief check whether the code at pc is an idle loop: loads, compares, BIT, AND and ORA on ram, rom or
+ * $2002, ending with a branch back to pc
+ *
+ * @param cpu
+ * @param pc
+ * @param loop filled in, with instructions set to 0 if the code is not an idle loop
+ * @return bool
  */
-void clock_cpu(State6502 *cpu);
\ No newline at end of file
+bool find_idle_loop(State6502 *cpu, uint16_t pc, IdleLoop *loop);
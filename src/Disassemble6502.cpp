@@ -2,172 +2,171 @@
 #include "Disassemble6502.h"
 
 /**
- * @brief decode 6502 operation from bytes
+ * @brief decode 6502 operation from bytes into a caller provided buffer
  * 
  * @param codebuffer 
- * @param pc 
- * @return int 
+ * @param output 
+ * @param size size of output
+ * @return char* output
  */
-char *Disassemble6502Op(uint8_t *codebuffer, int pc) {
+char *Disassemble6502Op(uint8_t *codebuffer, char *output, size_t size) {
     uint8_t *opcodes = &codebuffer[0];
-    char *output = (char *) malloc(100 * sizeof(char));
-    printf("%04x %02x ", pc, opcodes[0]); // print the program opbyteser addressl
 
     switch (opcodes[0]) 
     {
         // dissasemble hex code into operations in assembly
-        case 0x00: sprintf(output, "BRK"); break;
-        case 0x01: sprintf(output, "ORA ($%02x, X)", opcodes[1]); break;
-        case 0x05: sprintf(output, "ORA $%02x", opcodes[1]); break;
-        case 0x06: sprintf(output, "ASL $%02x", opcodes[1]); break;
-        case 0x08: sprintf(output, "PHP"); break;
-        case 0x09: sprintf(output, "ORA #$%02x", opcodes[1]); break;
-        case 0x0a: sprintf(output, "ASL A"); break;
-        case 0x0d: sprintf(output, "ORA $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x0e: sprintf(output, "ASL $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x10: sprintf(output, "BPL $%02x", opcodes[1]); break;
-        case 0x11: sprintf(output, "ORA ($%02x, Y)", opcodes[1]); break;
-        case 0x15: sprintf(output, "ORA $%02x X", opcodes[1]); break;
-        case 0x16: sprintf(output, "ASL $%02x X", opcodes[1]); break;
-        case 0x18: sprintf(output, "CLC"); break;
-        case 0x19: sprintf(output, "ORA $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0x1d: sprintf(output, "ORA $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x1e: sprintf(output, "ASL $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x20: sprintf(output, "JSR $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x21: sprintf(output, "AND ($%02x, X)", opcodes[1]); break;
-        case 0x24: sprintf(output, "BIT $%02x", opcodes[1]); break;
-        case 0x25: sprintf(output, "AND $%02x", opcodes[1]); break;
-        case 0x26: sprintf(output, "ROL $%02x", opcodes[1]); break;
-        case 0x28: sprintf(output, "PLP"); break;
-        case 0x29: sprintf(output, "AND #$%02x", opcodes[1]); break;
-        case 0x2a: sprintf(output, "ROL A"); break;
-        case 0x2c: sprintf(output, "BIT $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x2d: sprintf(output, "AND $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x2e: sprintf(output, "ROL $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x30: sprintf(output, "BMI $%02x", opcodes[1]); break;
-        case 0x31: sprintf(output, "AND ($%02x, Y)", opcodes[1]); break;
-        case 0x35: sprintf(output, "AND $%02x X", opcodes[1]); break;
-        case 0x36: sprintf(output, "ROL $%02x X", opcodes[1]); break;
-        case 0x38: sprintf(output, "SEC"); break;
-        case 0x39: sprintf(output, "AND $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0x3d: sprintf(output, "AND $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x3e: sprintf(output, "ROL $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x40: sprintf(output, "RTI"); break;
-        case 0x41: sprintf(output, "EOR ($%02x, X)", opcodes[1]); break;
-        case 0x45: sprintf(output, "EOR $%02x", opcodes[1]); break;
-        case 0x46: sprintf(output, "LSR $%02x", opcodes[1]); break;
-        case 0x48: sprintf(output, "PHA"); break;
-        case 0x49: sprintf(output, "EOR #$%02x", opcodes[1]); break;
-        case 0x4a: sprintf(output, "LSR A"); break;
-        case 0x4c: sprintf(output, "JMP $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x4d: sprintf(output, "EOR $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x4e: sprintf(output, "LSR $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x50: sprintf(output, "BVC $%02x", opcodes[1]); break;
-        case 0x51: sprintf(output, "EOR ($%02x, Y)", opcodes[1]); break;
-        case 0x55: sprintf(output, "EOR $%02x X", opcodes[1]); break;
-        case 0x56: sprintf(output, "LSR $%02x X", opcodes[1]); break;
-        case 0x58: sprintf(output, "CLI"); break;
-        case 0x59: sprintf(output, "EOR $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0x5d: sprintf(output, "EOR $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x5e: sprintf(output, "LSR $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x60: sprintf(output, "RTS"); break;
-        case 0x61: sprintf(output, "ADC ($%02x, X)", opcodes[1]); break;
-        case 0x65: sprintf(output, "ADC $%02x", opcodes[1]); break;
-        case 0x66: sprintf(output, "ROR $%02x", opcodes[1]); break;
-        case 0x68: sprintf(output, "PLA"); break;
-        case 0x69: sprintf(output, "ADC #$%02x", opcodes[1]); break;
-        case 0x6a: sprintf(output, "ROR A"); break;
-        case 0x6c: sprintf(output, "JMP ($%02x%02x)", opcodes[2], opcodes[1]); break;
-        case 0x6d: sprintf(output, "ADC $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x6e: sprintf(output, "ROR $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x70: sprintf(output, "BVS $%02x", opcodes[1]); break;
-        case 0x71: sprintf(output, "ADC ($%02x, Y)", opcodes[1]); break;
-        case 0x75: sprintf(output, "ADC $%02x X", opcodes[1]); break;
-        case 0x76: sprintf(output, "ROR $%02x X", opcodes[1]); break;
-        case 0x78: sprintf(output, "SEI"); break;
-        case 0x79: sprintf(output, "ADC $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0x7d: sprintf(output, "ADC $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0x7e: sprintf(output, "ROR $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x81: sprintf(output, "STA ($%02x, X)", opcodes[1]); break;
-        case 0x84: sprintf(output, "STY $%02x", opcodes[1]); break;
-        case 0x85: sprintf(output, "STA $%02x", opcodes[1]); break;
-        case 0x86: sprintf(output, "STX $%02x", opcodes[1]); break;
-        case 0x88: sprintf(output, "DEY"); break;
-        case 0x8a: sprintf(output, "TXA"); break;
-        case 0x8c: sprintf(output, "STY $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x8d: sprintf(output, "STA $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x8e: sprintf(output, "STX $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0x90: sprintf(output, "BCC $%02x", opcodes[1]); break;
-        case 0x91: sprintf(output, "STA ($%02x, Y)", opcodes[1]); break;
-        case 0x94: sprintf(output, "STY $%02x X", opcodes[1]); break;
-        case 0x95: sprintf(output, "STA $%02x X", opcodes[1]); break;
-        case 0x96: sprintf(output, "STX $%02x X", opcodes[1]); break;
-        case 0x98: sprintf(output, "TYA"); break;
-        case 0x99: sprintf(output, "STA $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0x9a: sprintf(output, "TXS"); break;
-        case 0x9d: sprintf(output, "STA $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0xa0: sprintf(output, "LDY #$%02x", opcodes[1]); break;
-        case 0xa1: sprintf(output, "LDA ($%02x, X)", opcodes[1]); break;
-        case 0xa2: sprintf(output, "LDX #$%02x", opcodes[1]); break;
-        case 0xa4: sprintf(output, "LDY $%02x", opcodes[1]); break;
-        case 0xa5: sprintf(output, "LDA $%02x", opcodes[1]); break;
-        case 0xa6: sprintf(output, "LDX $%02x", opcodes[1]); break;
-        case 0xa8: sprintf(output, "TAY"); break;
-        case 0xa9: sprintf(output, "LDA #$%02x", opcodes[1]); break;
-        case 0xaa: sprintf(output, "TAX"); break;
-        case 0xac: sprintf(output, "LDY $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xad: sprintf(output, "LDA $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xae: sprintf(output, "LDX $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xb0: sprintf(output, "BCS $%02x", opcodes[1]); break;
-        case 0xb1: sprintf(output, "LDA ($%02x, Y)", opcodes[1]); break;
-        case 0xb4: sprintf(output, "LDY $%02x X", opcodes[1]); break;
-        case 0xb5: sprintf(output, "LDA $%02x X", opcodes[1]); break;
-        case 0xb6: sprintf(output, "LDX $%02x X", opcodes[1]); break;
-        case 0xb8: sprintf(output, "CLV"); break;
-        case 0xb9: sprintf(output, "LDA $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0xba: sprintf(output, "TSX"); break;
-        case 0xbc: sprintf(output, "LDY $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0xbd: sprintf(output, "LDA $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0xbe: sprintf(output, "LDX $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0xc0: sprintf(output, "CPY #$%02x", opcodes[1]); break;
-        case 0xc1: sprintf(output, "CMP ($%02x, X)", opcodes[1]); break;
-        case 0xc4: sprintf(output, "CPY $%02x", opcodes[1]); break;
-        case 0xc5: sprintf(output, "CMP $%02x", opcodes[1]); break;
-        case 0xc6: sprintf(output, "DEC $%02x", opcodes[1]); break;
-        case 0xc8: sprintf(output, "INY"); break;
-        case 0xc9: sprintf(output, "CMP #$%02x", opcodes[1]); break;
-        case 0xca: sprintf(output, "DEX"); break;
-        case 0xcc: sprintf(output, "CPY $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xcd: sprintf(output, "CMP $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xce: sprintf(output, "DEC $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xd0: sprintf(output, "BNE $%02x", opcodes[1]); break;
-        case 0xd1: sprintf(output, "CMP ($%02x, Y)", opcodes[1]); break;
-        case 0xd5: sprintf(output, "CMP $%02x X", opcodes[1]); break;
-        case 0xd6: sprintf(output, "DEC $%02x X", opcodes[1]); break;
-        case 0xd8: sprintf(output, "CLD"); break;
-        case 0xd9: sprintf(output, "CMP $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0xdd: sprintf(output, "CMP $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0xde: sprintf(output, "DEC $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0xe0: sprintf(output, "CPX #$%02x", opcodes[1]); break;
-        case 0xe1: sprintf(output, "SBC ($%02x, X)", opcodes[1]); break;
-        case 0xe4: sprintf(output, "CPX $%02x", opcodes[1]); break;
-        case 0xe5: sprintf(output, "SBC $%02x", opcodes[1]); break;
-        case 0xe6: sprintf(output, "INC $%02x", opcodes[1]); break;
-        case 0xe8: sprintf(output, "INX"); break;
-        case 0xe9: sprintf(output, "SBC #$%02x", opcodes[1]); break;
-        case 0xea: sprintf(output, "NOP"); break;
-        case 0xec: sprintf(output, "CPX $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xed: sprintf(output, "SBC $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xee: sprintf(output, "INC $%02x%02x", opcodes[2], opcodes[1]); break;
-        case 0xf0: sprintf(output, "BEQ $%02x", opcodes[1]); break;
-        case 0xf1: sprintf(output, "SBC ($%02x, Y)", opcodes[1]); break;
-        case 0xf5: sprintf(output, "SBC $%02x X", opcodes[1]); break;
-        case 0xf6: sprintf(output, "INC $%02x X", opcodes[1]); break;
-        case 0xf8: sprintf(output, "SED"); break;
-        case 0xf9: sprintf(output, "SBC $%02x%02x Y", opcodes[2], opcodes[1]); break;
-        case 0xfd: sprintf(output, "SBC $%02x%02x X", opcodes[2], opcodes[1]); break;
-        case 0xfe: sprintf(output, "INC $%02x%02x X", opcodes[2], opcodes[1]); break;
-        default: sprintf(output, "INVALID OPERATION: %02x", opcodes[0]); break;
+        case 0x00: snprintf(output, size, "BRK"); break;
+        case 0x01: snprintf(output, size, "ORA ($%02x, X)", opcodes[1]); break;
+        case 0x05: snprintf(output, size, "ORA $%02x", opcodes[1]); break;
+        case 0x06: snprintf(output, size, "ASL $%02x", opcodes[1]); break;
+        case 0x08: snprintf(output, size, "PHP"); break;
+        case 0x09: snprintf(output, size, "ORA #$%02x", opcodes[1]); break;
+        case 0x0a: snprintf(output, size, "ASL A"); break;
+        case 0x0d: snprintf(output, size, "ORA $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x0e: snprintf(output, size, "ASL $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x10: snprintf(output, size, "BPL $%02x", opcodes[1]); break;
+        case 0x11: snprintf(output, size, "ORA ($%02x, Y)", opcodes[1]); break;
+        case 0x15: snprintf(output, size, "ORA $%02x X", opcodes[1]); break;
+        case 0x16: snprintf(output, size, "ASL $%02x X", opcodes[1]); break;
+        case 0x18: snprintf(output, size, "CLC"); break;
+        case 0x19: snprintf(output, size, "ORA $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0x1d: snprintf(output, size, "ORA $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x1e: snprintf(output, size, "ASL $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x20: snprintf(output, size, "JSR $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x21: snprintf(output, size, "AND ($%02x, X)", opcodes[1]); break;
+        case 0x24: snprintf(output, size, "BIT $%02x", opcodes[1]); break;
+        case 0x25: snprintf(output, size, "AND $%02x", opcodes[1]); break;
+        case 0x26: snprintf(output, size, "ROL $%02x", opcodes[1]); break;
+        case 0x28: snprintf(output, size, "PLP"); break;
+        case 0x29: snprintf(output, size, "AND #$%02x", opcodes[1]); break;
+        case 0x2a: snprintf(output, size, "ROL A"); break;
+        case 0x2c: snprintf(output, size, "BIT $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x2d: snprintf(output, size, "AND $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x2e: snprintf(output, size, "ROL $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x30: snprintf(output, size, "BMI $%02x", opcodes[1]); break;
+        case 0x31: snprintf(output, size, "AND ($%02x, Y)", opcodes[1]); break;
+        case 0x35: snprintf(output, size, "AND $%02x X", opcodes[1]); break;
+        case 0x36: snprintf(output, size, "ROL $%02x X", opcodes[1]); break;
+        case 0x38: snprintf(output, size, "SEC"); break;
+        case 0x39: snprintf(output, size, "AND $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0x3d: snprintf(output, size, "AND $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x3e: snprintf(output, size, "ROL $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x40: snprintf(output, size, "RTI"); break;
+        case 0x41: snprintf(output, size, "EOR ($%02x, X)", opcodes[1]); break;
+        case 0x45: snprintf(output, size, "EOR $%02x", opcodes[1]); break;
+        case 0x46: snprintf(output, size, "LSR $%02x", opcodes[1]); break;
+        case 0x48: snprintf(output, size, "PHA"); break;
+        case 0x49: snprintf(output, size, "EOR #$%02x", opcodes[1]); break;
+        case 0x4a: snprintf(output, size, "LSR A"); break;
+        case 0x4c: snprintf(output, size, "JMP $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x4d: snprintf(output, size, "EOR $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x4e: snprintf(output, size, "LSR $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x50: snprintf(output, size, "BVC $%02x", opcodes[1]); break;
+        case 0x51: snprintf(output, size, "EOR ($%02x, Y)", opcodes[1]); break;
+        case 0x55: snprintf(output, size, "EOR $%02x X", opcodes[1]); break;
+        case 0x56: snprintf(output, size, "LSR $%02x X", opcodes[1]); break;
+        case 0x58: snprintf(output, size, "CLI"); break;
+        case 0x59: snprintf(output, size, "EOR $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0x5d: snprintf(output, size, "EOR $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x5e: snprintf(output, size, "LSR $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x60: snprintf(output, size, "RTS"); break;
+        case 0x61: snprintf(output, size, "ADC ($%02x, X)", opcodes[1]); break;
+        case 0x65: snprintf(output, size, "ADC $%02x", opcodes[1]); break;
+        case 0x66: snprintf(output, size, "ROR $%02x", opcodes[1]); break;
+        case 0x68: snprintf(output, size, "PLA"); break;
+        case 0x69: snprintf(output, size, "ADC #$%02x", opcodes[1]); break;
+        case 0x6a: snprintf(output, size, "ROR A"); break;
+        case 0x6c: snprintf(output, size, "JMP ($%02x%02x)", opcodes[2], opcodes[1]); break;
+        case 0x6d: snprintf(output, size, "ADC $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x6e: snprintf(output, size, "ROR $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x70: snprintf(output, size, "BVS $%02x", opcodes[1]); break;
+        case 0x71: snprintf(output, size, "ADC ($%02x, Y)", opcodes[1]); break;
+        case 0x75: snprintf(output, size, "ADC $%02x X", opcodes[1]); break;
+        case 0x76: snprintf(output, size, "ROR $%02x X", opcodes[1]); break;
+        case 0x78: snprintf(output, size, "SEI"); break;
+        case 0x79: snprintf(output, size, "ADC $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0x7d: snprintf(output, size, "ADC $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0x7e: snprintf(output, size, "ROR $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x81: snprintf(output, size, "STA ($%02x, X)", opcodes[1]); break;
+        case 0x84: snprintf(output, size, "STY $%02x", opcodes[1]); break;
+        case 0x85: snprintf(output, size, "STA $%02x", opcodes[1]); break;
+        case 0x86: snprintf(output, size, "STX $%02x", opcodes[1]); break;
+        case 0x88: snprintf(output, size, "DEY"); break;
+        case 0x8a: snprintf(output, size, "TXA"); break;
+        case 0x8c: snprintf(output, size, "STY $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x8d: snprintf(output, size, "STA $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x8e: snprintf(output, size, "STX $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0x90: snprintf(output, size, "BCC $%02x", opcodes[1]); break;
+        case 0x91: snprintf(output, size, "STA ($%02x, Y)", opcodes[1]); break;
+        case 0x94: snprintf(output, size, "STY $%02x X", opcodes[1]); break;
+        case 0x95: snprintf(output, size, "STA $%02x X", opcodes[1]); break;
+        case 0x96: snprintf(output, size, "STX $%02x X", opcodes[1]); break;
+        case 0x98: snprintf(output, size, "TYA"); break;
+        case 0x99: snprintf(output, size, "STA $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0x9a: snprintf(output, size, "TXS"); break;
+        case 0x9d: snprintf(output, size, "STA $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0xa0: snprintf(output, size, "LDY #$%02x", opcodes[1]); break;
+        case 0xa1: snprintf(output, size, "LDA ($%02x, X)", opcodes[1]); break;
+        case 0xa2: snprintf(output, size, "LDX #$%02x", opcodes[1]); break;
+        case 0xa4: snprintf(output, size, "LDY $%02x", opcodes[1]); break;
+        case 0xa5: snprintf(output, size, "LDA $%02x", opcodes[1]); break;
+        case 0xa6: snprintf(output, size, "LDX $%02x", opcodes[1]); break;
+        case 0xa8: snprintf(output, size, "TAY"); break;
+        case 0xa9: snprintf(output, size, "LDA #$%02x", opcodes[1]); break;
+        case 0xaa: snprintf(output, size, "TAX"); break;
+        case 0xac: snprintf(output, size, "LDY $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xad: snprintf(output, size, "LDA $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xae: snprintf(output, size, "LDX $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xb0: snprintf(output, size, "BCS $%02x", opcodes[1]); break;
+        case 0xb1: snprintf(output, size, "LDA ($%02x, Y)", opcodes[1]); break;
+        case 0xb4: snprintf(output, size, "LDY $%02x X", opcodes[1]); break;
+        case 0xb5: snprintf(output, size, "LDA $%02x X", opcodes[1]); break;
+        case 0xb6: snprintf(output, size, "LDX $%02x X", opcodes[1]); break;
+        case 0xb8: snprintf(output, size, "CLV"); break;
+        case 0xb9: snprintf(output, size, "LDA $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0xba: snprintf(output, size, "TSX"); break;
+        case 0xbc: snprintf(output, size, "LDY $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0xbd: snprintf(output, size, "LDA $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0xbe: snprintf(output, size, "LDX $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0xc0: snprintf(output, size, "CPY #$%02x", opcodes[1]); break;
+        case 0xc1: snprintf(output, size, "CMP ($%02x, X)", opcodes[1]); break;
+        case 0xc4: snprintf(output, size, "CPY $%02x", opcodes[1]); break;
+        case 0xc5: snprintf(output, size, "CMP $%02x", opcodes[1]); break;
+        case 0xc6: snprintf(output, size, "DEC $%02x", opcodes[1]); break;
+        case 0xc8: snprintf(output, size, "INY"); break;
+        case 0xc9: snprintf(output, size, "CMP #$%02x", opcodes[1]); break;
+        case 0xca: snprintf(output, size, "DEX"); break;
+        case 0xcc: snprintf(output, size, "CPY $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xcd: snprintf(output, size, "CMP $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xce: snprintf(output, size, "DEC $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xd0: snprintf(output, size, "BNE $%02x", opcodes[1]); break;
+        case 0xd1: snprintf(output, size, "CMP ($%02x, Y)", opcodes[1]); break;
+        case 0xd5: snprintf(output, size, "CMP $%02x X", opcodes[1]); break;
+        case 0xd6: snprintf(output, size, "DEC $%02x X", opcodes[1]); break;
+        case 0xd8: snprintf(output, size, "CLD"); break;
+        case 0xd9: snprintf(output, size, "CMP $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0xdd: snprintf(output, size, "CMP $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0xde: snprintf(output, size, "DEC $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0xe0: snprintf(output, size, "CPX #$%02x", opcodes[1]); break;
+        case 0xe1: snprintf(output, size, "SBC ($%02x, X)", opcodes[1]); break;
+        case 0xe4: snprintf(output, size, "CPX $%02x", opcodes[1]); break;
+        case 0xe5: snprintf(output, size, "SBC $%02x", opcodes[1]); break;
+        case 0xe6: snprintf(output, size, "INC $%02x", opcodes[1]); break;
+        case 0xe8: snprintf(output, size, "INX"); break;
+        case 0xe9: snprintf(output, size, "SBC #$%02x", opcodes[1]); break;
+        case 0xea: snprintf(output, size, "NOP"); break;
+        case 0xec: snprintf(output, size, "CPX $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xed: snprintf(output, size, "SBC $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xee: snprintf(output, size, "INC $%02x%02x", opcodes[2], opcodes[1]); break;
+        case 0xf0: snprintf(output, size, "BEQ $%02x", opcodes[1]); break;
+        case 0xf1: snprintf(output, size, "SBC ($%02x, Y)", opcodes[1]); break;
+        case 0xf5: snprintf(output, size, "SBC $%02x X", opcodes[1]); break;
+        case 0xf6: snprintf(output, size, "INC $%02x X", opcodes[1]); break;
+        case 0xf8: snprintf(output, size, "SED"); break;
+        case 0xf9: snprintf(output, size, "SBC $%02x%02x Y", opcodes[2], opcodes[1]); break;
+        case 0xfd: snprintf(output, size, "SBC $%02x%02x X", opcodes[2], opcodes[1]); break;
+        case 0xfe: snprintf(output, size, "INC $%02x%02x X", opcodes[2], opcodes[1]); break;
+        default: snprintf(output, size, "INVALID OPERATION: %02x", opcodes[0]); break;
 
     }
     
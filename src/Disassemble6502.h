@@ -1,11 +1,13 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 /**
- * @brief decode 6502 operation from bytes
+ * @brief decode 6502 operation from bytes into a caller provided buffer
  * 
  * @param codebuffer 
- * @param pc 
- * @return int 
+ * @param output 
+ * @param size size of output
+ * @return char* output
  */
-char *Disassemble6502Op(uint8_t *codebuffer, int pc);
\ No newline at end of file
+char *Disassemble6502Op(uint8_t *codebuffer, char *output, size_t size);
\ No newline at end of file
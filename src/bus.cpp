@@ -4,8 +4,20 @@
 #include "6502.h"
 #include "controller.h"
 #include "mapper.hpp"
+#include "profile.h"
 
-void cpu_write_to_bus(Bus *bus, uint16_t address, uint8_t value) {
+// sprite backdrop entries $3F10/$14/$18/$1C alias the background ones
+static const uint8_t PALETTE_MIRROR[0x20] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x00, 0x11, 0x12, 0x13, 0x04, 0x15, 0x16, 0x17, 0x08, 0x19, 0x1a, 0x1b, 0x0c, 0x1d, 0x1e, 0x1f
+};
+
+// the ppu only has to be caught up to the current cpu cycle when the cpu can observe or change it
+static inline void sync_ppu(Bus *bus) {
+    catch_up_ppu(bus, bus->cpu_clock + 1);
+}
+
+void cpu_write_to_io(Bus *bus, uint16_t address, uint8_t value) {
     if (address <= 0x1fff) {
         // CPU RAM
         address &= 0x07ff;
@@ -16,6 +28,7 @@ void cpu_write_to_bus(Bus *bus, uint16_t address, uint8_t value) {
         // PPU REGISTERS
         address &= 0x0007;
         // printf("CPU WRITING %02x TO REGISTER 20%02x\n", value, address);
+        sync_ppu(bus);
 
         write_to_ppu_register(bus->ppu, address, value);
         // getchar();
@@ -23,16 +36,22 @@ void cpu_write_to_bus(Bus *bus, uint16_t address, uint8_t value) {
 
     else if (address <= 0x4017) {
         // APU/IO REGISTERS
-        if (address == 0x4014)
+        if (address == 0x4014) {
+            // OAM DMA copies the page at once, the cpu is halted for 513 cycles (514 from an odd cycle)
+            sync_ppu(bus);
             write_to_ppu_register(bus->ppu, address, value);
+            bus->cpu_clock += 3 * (513 + ((bus->cpu_clock / 3) & 1));
+        }
         else if (address == 0x4016) {
-            // CONTROLLER
+            // CONTROLLER, the strobe goes to both ports
             if ((value & 0x1) == 1) {
                 bus->poll_input1 = -1;
+                bus->poll_input2 = -1;
             }
 
             else if ((value & 0x1) == 0) {
                 bus->poll_input1 = 0;
+                bus->poll_input2 = 0;
             }
         }
 
@@ -42,19 +61,30 @@ void cpu_write_to_bus(Bus *bus, uint16_t address, uint8_t value) {
         }
     }
 
-    else if (address >= 0x4020 && address <= 0xffff) {
+    else if (address >= 0x8000) {
+        // PRG ROM is never written, writes are mapper register accesses
+        sync_ppu(bus);
+        PROFILE_START(start);
+        bus->mapper->handle_write(address, value);
+        PROFILE_STOP(PROFILE_MAPPER, start);
+    }
+
+    else if (address >= 0x4020) {
         if (bus->mapper->allow_cpu_writes) {
             address -= 0x4020;
             bus->unmapped[address] = value;
         }
 
         else {
+            sync_ppu(bus);
+            PROFILE_START(start);
             bus->mapper->handle_write(address, value);
+            PROFILE_STOP(PROFILE_MAPPER, start);
         }
     }
 }
 
-uint8_t cpu_read_from_bus(Bus *bus, uint16_t address) {
+uint8_t cpu_read_from_io(Bus *bus, uint16_t address) {
     uint8_t value = 0;
     if (address <= 0x1fff) {
         address &= 0x07ff;
@@ -64,12 +94,14 @@ uint8_t cpu_read_from_bus(Bus *bus, uint16_t address) {
     else if (address <= 0x3fff) {
         address &= 0x0007;
         // printf("CPU READING %02x FROM REGISTER 20%02x\n", value, address);
+        sync_ppu(bus);
         value = read_from_ppu_register(bus->ppu, address);
 
     }
 
     else if (address <= 0x4017) {
         if (address == 0x4014) {
+            sync_ppu(bus);
             value = read_from_ppu_register(bus->ppu, address);
         }
 
@@ -90,13 +122,25 @@ uint8_t cpu_read_from_bus(Bus *bus, uint16_t address) {
 
         }
 
-        else if (address = 0x4017) {
-            value = 0;
+        else if (address == 0x4017 && bus->controller_2) {
+            if (bus->poll_input2 >= 0) {
+                value = 0x40 | read_from_controller(bus->controller_2, bus->poll_input2++);
+                if (bus->poll_input2 > 7)
+                    bus->poll_input2 = -1;
+            }
+
+            else if (bus->poll_input2 == -1) {
+                value = 0x40 | read_from_controller(bus->controller_2, 0);
+            }
         }
 
     }
 
-    else if (address >= 0x4020 && address <= 0xffff) {
+    else if (address >= 0x8000) {
+        value = bus->prg_windows[(address >> 13) & 0x3][address & 0x1fff];
+    }
+
+    else if (address >= 0x4020) {
         address -= 0x4020;
         value = bus->unmapped[address];
     }
@@ -104,185 +148,355 @@ uint8_t cpu_read_from_bus(Bus *bus, uint16_t address) {
     return value;
 }
 
-void ppu_write_to_bus(Bus *bus, uint16_t address, uint8_t value) {
-    if (address < 0x3f00 && bus->mapper->chr_bank_switch == false)
-        bus->a12_state_current = (address & 0x1000) != 0;
-
-    if (address <= 0x0fff) {
-        bus->pattern_table_0[address] = value;
+void map_cpu_pages(Bus *bus, uint16_t address, uint32_t size, uint8_t *read, uint8_t *write) {
+    for (uint32_t offset = 0; offset < size; offset += 0x100) {
+        uint8_t page = (address + offset) >> 8;
+        bus->cpu_read_pages[page] = read ? read + offset : NULL;
+        bus->cpu_write_pages[page] = write ? write + offset : NULL;
     }
+}
 
-    else if (address <= 0x1fff) {
-        address &= 0x0fff;
-        bus->pattern_table_1[address] = value;
-    }
+void map_chr_window(Bus *bus, uint8_t slot, uint8_t *memory) {
+    if (bus->chr_windows[slot] == memory)
+        return;
 
-    else if (address <= 0x2fff) {
-        if (bus->ppu->mirror_mode == SINGLE_SCREEN_LOWER) {
-            address &= 0x03ff;
-            bus->name_table_0[address] = value;
-        }
+    COUNT_BY(chr_bytes_remapped, 0x400);
+    bus->chr_windows[slot] = memory;
+    memset(&bus->chr_tile_valid[slot * 64], 0, 64 * sizeof(bool));
+}
 
-        else if (bus->ppu->mirror_mode == SINGLE_SCREEN_UPPER) {
-            address &= 0x03ff;
-            bus->name_table_1[address] = value;
+void decode_chr_tile(Bus *bus, uint16_t tile) {
+    COUNT(chr_tiles_decoded);
+    uint8_t *pattern = &bus->chr_windows[tile >> 6][(tile & 0x3f) * 16];
+
+    for (int row = 0; row < 8; row++) {
+        uint64_t pixels = 0;
+        uint64_t flipped = 0;
+        for (int pixel = 0; pixel < 8; pixel++) {
+            uint64_t value = ((pattern[row] >> (7 - pixel)) & 1) | (((pattern[row + 8] >> (7 - pixel)) & 1) << 1);
+            pixels |= value << (pixel * 8);
+            flipped |= value << ((7 - pixel) * 8);
         }
 
-        else {
-            if (address <= 0x23ff) {
-                address &= 0x03ff;
-                bus->name_table_0[address] = value;
-            }
+        bus->chr_rows[tile * 8 + row] = pixels;
+        bus->chr_rows_flipped[tile * 8 + row] = flipped;
+    }
 
-            else if (address <= 0x27ff) {
-                address &= 0x03ff;
-                if (bus->ppu->mirror_mode == HORIZONTAL)
-                    bus->name_table_0[address] = value;
-                else
-                    bus->name_table_1[address] = value;
-            }
+    bus->chr_tile_valid[tile] = true;
+}
 
-            else if (address <= 0x2bff) {
-                address &= 0x03ff;
-                if (bus->ppu->mirror_mode == HORIZONTAL)
-                    bus->name_table_1[address] = value;
-                else
-                    bus->name_table_0[address] = value;
-            }
+void ppu_write_to_bus(Bus *bus, uint16_t address, uint8_t value) {
+    COUNT(ppu_writes[ppu_region(address)]);
+    if (address < 0x3f00)
+        bus->a12_state_current = (address & 0x1000) != 0;
 
-            else if (address <= 0x2fff) {
-                address &= 0x03ff;
-                bus->name_table_1[address] = value;
+    if (address <= 0x1fff) {
+        if (bus->chr_writable) {
+            uint8_t *byte = &bus->chr_windows[address >> 10][address & 0x03ff];
+            *byte = value;
+
+            // the byte may be visible through more than one window
+            for (int slot = 0; slot < 8; slot++) {
+                if (byte >= bus->chr_windows[slot] && byte < bus->chr_windows[slot] + 0x400)
+                    bus->chr_tile_valid[slot * 64 + ((byte - bus->chr_windows[slot]) >> 4)] = false;
             }
         }
     }
 
-    else if (address >= 0x3f00 && address <= 0x3fff) {
-        address &= 0x1f;
-
-        if (address == 0x0010)
-            address = 0x0000;
-        if (address == 0x0014)
-            address = 0x0004;
-        if (address == 0x0018)
-            address = 0x0008;
-        if (address == 0x001C)
-            address = 0x000C;
+    else if (address < 0x3f00) {
+        bus->name_tables[(address >> 10) & 0x3][address & 0x03ff] = value;
+    }
 
-        bus->palette[address] = value;
+    else {
+        bus->palette[PALETTE_MIRROR[address & 0x1f]] = value;
     }
 }
 
 uint8_t ppu_read_from_bus(Bus *bus, uint16_t address) {
+    COUNT(ppu_reads[ppu_region(address)]);
     if (address < 0x3f00)
         bus->a12_state_current = (address & 0x1000) != 0;
 
     uint8_t value = 0;
-    if (address <= 0x0fff) {
-        value = bus->pattern_table_0[address];
+    if (address <= 0x1fff) {
+        value = bus->chr_windows[address >> 10][address & 0x03ff];
     }
 
-    else if (address <= 0x1fff) {
-        address &= 0x0fff;
-        value = bus->pattern_table_1[address];
+    else if (address < 0x3f00) {
+        value = bus->name_tables[(address >> 10) & 0x3][address & 0x03ff];
     }
 
-    else if (address <= 0x2fff) {
-        if (bus->ppu->mirror_mode == SINGLE_SCREEN_LOWER) {
-            address &= 0x03ff;
-            value = bus->name_table_0[address];
-        }
+    else {
+        value = bus->palette[PALETTE_MIRROR[address & 0x1f]];
+    }
 
-        else if (bus->ppu->mirror_mode == SINGLE_SCREEN_UPPER) {
-            address &= 0x03ff;
-            value = bus->name_table_1[address];
-        }
+    return value;
+}
 
-        else {
-            if (address <= 0x23ff) {
-                address &= 0x03ff;
-                value = bus->name_table_0[address];
-            }
+// timing every a12 check would cost more than the checks, one in 16 is timed and counted 16 times
+static inline void check_a12(Bus *bus) {
+#ifdef NES_PROFILE
+    if ((bus->system_cycles & 0xf) == 0) {
+        uint64_t start = profile_ticks();
+        bus->mapper->check_a12_rising_edge();
+        uint64_t ticks = profile_ticks() - start;
+        if (ticks > profile.overhead)
+            profile.ticks[PROFILE_MAPPER] += 16 * (ticks - profile.overhead);
+        return;
+    }
+#endif
+    bus->mapper->check_a12_rising_edge();
+}
 
-            else if (address <= 0x27ff) {
-                address &= 0x03ff;
-                if (bus->ppu->mirror_mode == HORIZONTAL)
-                    value = bus->name_table_0[address];
-                else if (bus->ppu->mirror_mode = VERTICAL)
-                    value = bus->name_table_1[address];
-            }
+void catch_up_ppu(Bus *bus, uint64_t target) {
+    if (bus->system_cycles >= target)
+        return;
+
+#ifdef NES_PROFILE
+    uint64_t start = profile_ticks();
+    uint64_t mapper_start = profile.ticks[PROFILE_MAPPER];
+#endif
+
+    State2C02 *ppu = bus->ppu;
+    if (bus->mapper->watches_a12) {
+        while (bus->system_cycles < target) {
+            clock_ppu(ppu);
+            check_a12(bus);
+            bus->system_cycles++;
+        }
+    }
 
-            else if (address <= 0x2bff) {
-                address &= 0x03ff;
-                if (bus->ppu->mirror_mode == HORIZONTAL)
-                    value = bus->name_table_1[address];
-                else if (bus->ppu->mirror_mode = VERTICAL)
-                    value = bus->name_table_0[address];
-            }
+    else {
+        while (bus->system_cycles < target) {
+            // the cpu cannot touch the ppu before target, so whole scanlines can be drawn at once
+            uint32_t cycles = 0;
+            if (target - bus->system_cycles >= 257)
+                cycles = clock_ppu_scanline(ppu);
 
-            else if (address <= 0x2fff) {
-                address &= 0x03ff;
-                value = bus->name_table_1[address];
+            if (cycles == 0) {
+                clock_ppu(ppu);
+                cycles = 1;
             }
+
+            bus->system_cycles += cycles;
         }
     }
 
-    else if (address >= 0x3f00 && address <= 0x3fff) {
-        address &= 0x001f;
+    bus->ppu_deadline = bus->system_cycles + cycles_until_vblank(ppu);
 
-        if (address == 0x0010)
-            address = 0x0000;
-        if (address == 0x0014)
-            address = 0x0004;
-        if (address == 0x0018)
-            address = 0x0008;
-        if (address == 0x001C)
-            address = 0x000C;
+#ifdef NES_PROFILE
+    // the a12 checks in the loop count as mapper time
+    uint64_t ticks = profile_ticks() - start - (profile.ticks[PROFILE_MAPPER] - mapper_start);
+    if (ticks > profile.overhead)
+        profile.ticks[PROFILE_PPU] += ticks - profile.overhead;
+#endif
+}
+
+// interrupts are taken between instructions, each one (and reset) delays the next instruction
+static inline void take_interrupts(Bus *bus) {
+    State6502 *cpu = bus->cpu;
+    State2C02 *ppu = bus->ppu;
+
+    while (true) {
+        if (bus->mapper->watches_a12 || bus->cpu_clock > bus->ppu_deadline)
+            catch_up_ppu(bus, bus->cpu_clock);
+
+        uint64_t start = bus->cpu_clock;
+
+        if (ppu->status.vblank && ppu->nmi) {
+            ppu->nmi = false;
+            nmi(cpu);
+        }
 
-        value = bus->palette[address];
+        if (bus->irq_pending) {
+            bus->irq_pending = false;
+            irq(cpu);
+        }
+
+        if (cpu->cycles == 0)
+            break;
+
+        if (bus->cpu_clock < start + 3 * cpu->cycles)
+            bus->cpu_clock = start + 3 * cpu->cycles;
+        cpu->cycles = 0;
     }
+}
 
-    return value;
+// each bus access of the cpu moves cpu_clock on by one cpu cycle as it happens, so the ppu and mapper
+// see register accesses at their own cycle. cycles without an access are added at the end
+static inline void finish_instruction(Bus *bus, uint64_t start, uint32_t cycles) {
+    if (bus->cpu_clock < start + 3 * cycles)
+        bus->cpu_clock = start + 3 * cycles;
+}
+
+static inline void run_instruction(Bus *bus, uint32_t (*step)(State6502 *cpu)) {
+    take_interrupts(bus);
+
+    uint64_t start = bus->cpu_clock;
+    finish_instruction(bus, start, step(bus->cpu));
+}
+
+// whether clock_bus (or run_frame) would do anything before the next instruction
+static inline bool between_instructions_work(Bus *bus) {
+    State2C02 *ppu = bus->ppu;
+    return bus->mapper->watches_a12 || bus->cpu_clock > bus->ppu_deadline || (ppu->status.vblank && ppu->nmi) ||
+           bus->irq_pending || bus->cpu->cycles || ppu->frame_complete;
 }
 
-void clock_bus(Bus *bus, SDL_Window *window) {
-    clock_ppu(bus->ppu, window);
-    if (bus->system_cycles % 3 == 0 && !bus->ppu->oamdma_write) {
-        clock_cpu(bus->cpu);
+// runs decoded rom instructions back to back for as long as the interpreter would have nothing to do
+// between them, so the result is the same as calling run_instruction for each
+static inline void run_block(Bus *bus) {
+    State6502 *cpu = bus->cpu;
+    take_interrupts(bus);
+
+    DecodedOp *op = cpu->debug ? NULL : lookup_block(cpu);
+    if (!op) {
+        uint64_t start = bus->cpu_clock;
+        finish_instruction(bus, start, step_cpu(cpu));
+        return;
     }
 
-    if (bus->ppu->status.vblank && bus->ppu->nmi && !bus->ppu->oamdma_write) {
-        bus->ppu->nmi = false;
-        nmi(bus->cpu);
+    // a write to a mapper register can switch out the bank the block is in
+    uint8_t slot = (cpu->pc >> 13) & 0x3;
+    uint8_t *window = bus->prg_windows[slot];
+
+    while (true) {
+        uint64_t start = bus->cpu_clock;
+        finish_instruction(bus, start, step_decoded(cpu, op));
+
+        if (op->ends_block || between_instructions_work(bus) || bus->prg_windows[slot] != window)
+            break;
+
+        op += op->bytes;
+        if (!op->handler || op->uncached) {
+            op = lookup_block(cpu);
+            if (!op)
+                break;
+        }
     }
+}
 
-        
-    bus->mapper->check_a12_rising_edge();
+// called when pc has gone back, which is how a loop is seen from here. the first time a loop's start is
+// reached it is checked with find_idle_loop, the second time shows how long a pass takes, and from then on
+// the cpu can jump ahead by whole passes for as long as nothing else can change what the loop reads.
+// every pass after the first ends in the same state, so this gives the same result as running them
+static void skip_idle_loop(Bus *bus) {
+    State6502 *cpu = bus->cpu;
+    State2C02 *ppu = bus->ppu;
+    IdleLoop *loop = cpu->idle_loop;
+
+    if (cpu->pc != loop->pc)
+        find_idle_loop(cpu, cpu->pc, loop);
+
+    // an interrupt or dma in between means the last pass was not a plain one
+    uint64_t pass = 3 * (uint64_t)loop->cycles;
+    bool plain_pass = loop->instructions && bus->cpu_clock - loop->pass_clock == pass &&
+                      cpu->instructions - loop->pass_instructions == loop->instructions;
+
+    loop->pass_clock = bus->cpu_clock;
+    loop->pass_instructions = cpu->instructions;
+
+    // irqs from a12 can't be predicted without clocking the ppu
+    if (!plain_pass || bus->mapper->watches_a12 || bus->irq_pending || (ppu->status.vblank && ppu->nmi) ||
+        ppu->frame_complete)
+        return;
+
+    // the next nmi (or a change of PPUSTATUS) is the first thing that can end the loop, stop one pass short of it
+    uint64_t event = bus->ppu_deadline;
+    if (loop->polls_ppu_status) {
+        uint64_t status_change = bus->system_cycles + cycles_until_status_change(ppu);
+        if (status_change < event)
+            event = status_change;
+    }
+
+    if (bus->cpu_clock + 2 * pass > event)
+        return;
+
+    uint64_t passes = (event - bus->cpu_clock) / pass - 1;
+    bus->cpu_clock += passes * pass;
+    cpu->instructions += passes * loop->instructions;
+    loop->skipped_cycles += passes * loop->cycles;
 
-    bus->system_cycles++;
+    loop->pass_clock = bus->cpu_clock;
+    loop->pass_instructions = cpu->instructions;
+}
+
+void clock_bus(Bus *bus) {
+    uint16_t pc = bus->cpu->pc;
+
+    if (bus->cpu->block_cache)
+        run_block(bus);
+    else
+        run_instruction(bus, step_cpu);
+
+    if (bus->cpu->idle_loop && bus->cpu->pc <= pc)
+        skip_idle_loop(bus);
+}
+
+void clock_bus_with(Bus *bus, uint32_t (*step)(State6502 *cpu)) {
+    uint16_t pc = bus->cpu->pc;
+
+    run_instruction(bus, step);
+
+    if (bus->cpu->idle_loop && bus->cpu->pc <= pc)
+        skip_idle_loop(bus);
+}
+
+void run_frame(Bus *bus) {
+    while (!bus->ppu->frame_complete)
+        clock_bus(bus);
+
+    bus->ppu->frame_complete = false;
 }
 
 Bus *InitBus(void) {
     Bus *bus = (Bus *)malloc(sizeof(Bus));
 
-    bus->cpu_ram = (uint8_t *)malloc(0x800);
-    bus->ppu_registers = (uint8_t *)malloc(0x8);
-    bus->apu_io_registers = (uint8_t *)malloc(0x18);
-    bus->unmapped = (uint8_t *)malloc(0xBFE0);
-
-    bus->pattern_table_0 = (uint8_t *)malloc(0x1000);
-    bus->pattern_table_1 = (uint8_t *)malloc(0x1000);
-    bus->name_table_0 = (uint8_t *)malloc(0x0400);
-    bus->name_table_1 = (uint8_t *)malloc(0x0400);
-    bus->name_table_2 = (uint8_t *)malloc(0x0400);
-    bus->name_table_3 = (uint8_t *)malloc(0x0400);
-    bus->palette = (uint8_t *)malloc(0x20);
+    // memory powers on cleared, so every run from power on is the same
+    bus->cpu_ram = (uint8_t *)calloc(0x800, 1);
+    bus->ppu_registers = (uint8_t *)calloc(0x8, 1);
+    bus->apu_io_registers = (uint8_t *)calloc(0x18, 1);
+    bus->unmapped = (uint8_t *)calloc(0x3FE0, 1);
+
+    bus->chr_ram = (uint8_t *)calloc(0x2000, 1);
+    bus->name_table_0 = (uint8_t *)calloc(0x0400, 1);
+    bus->name_table_1 = (uint8_t *)calloc(0x0400, 1);
+    bus->name_table_2 = (uint8_t *)calloc(0x0400, 1);
+    bus->name_table_3 = (uint8_t *)calloc(0x0400, 1);
+    bus->palette = (uint8_t *)calloc(0x20, 1);
+
+    // vertical mirroring until a mapper sets its mode
+    bus->name_tables[0] = bus->name_tables[2] = bus->name_table_0;
+    bus->name_tables[1] = bus->name_tables[3] = bus->name_table_1;
+
+    for (int i = 0; i < 4; i++)
+        bus->prg_windows[i] = NULL;
+    for (int i = 0; i < 8; i++)
+        bus->chr_windows[i] = NULL;
+    bus->chr_writable = false;
+
+    bus->chr_rows = (uint64_t *)malloc(512 * 8 * sizeof(uint64_t));
+    bus->chr_rows_flipped = (uint64_t *)malloc(512 * 8 * sizeof(uint64_t));
+    bus->chr_tile_valid = (bool *)calloc(512, sizeof(bool));
+
+    // only ram and cartridge space get direct pages, everything else goes through the io handlers
+    map_cpu_pages(bus, 0x0000, 0x10000, NULL, NULL);
+    for (int mirror = 0; mirror < 0x2000; mirror += 0x800)
+        map_cpu_pages(bus, mirror, 0x800, bus->cpu_ram, bus->cpu_ram);
+    map_cpu_pages(bus, 0x4100, 0x3f00, bus->unmapped + 0xe0, NULL);
 
     bus->mapper = NULL;
     bus->cpu = NULL;
     bus->ppu = NULL;
+    bus->controller_1 = NULL;
+    bus->controller_2 = NULL;
 
     bus->system_cycles = 0;
+    bus->cpu_clock = 0;
+    bus->ppu_deadline = 0;
+    bus->irq_pending = false;
+    bus->a12_state_previous = false;
+    bus->a12_state_current = false;
 
     bus->poll_input1 = 0;
     bus->poll_input2 = 0;
@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "mapper.hpp"
+#include "profile.h"
 
 #ifndef BUS_HPP
 #define BUS_HPP
@@ -10,16 +11,30 @@ typedef struct Bus {
     uint8_t *cpu_ram;           // $0000–$07FF, mirrored until $1FFF
     uint8_t *ppu_registers;     // $2000–$2007, mirrored until $3FFF
     uint8_t *apu_io_registers;  // $4000–$4017
-    uint8_t *unmapped;          // $4020–$FFFF, generally used for cartridge ram, rom, and mapper registers
+    uint8_t *unmapped;          // $4020–$7FFF, generally used for cartridge ram and mapper registers
 
     // PPU ADDRESSES
-    uint8_t *pattern_table_0;  // $0000-$0FFF
-    uint8_t *pattern_table_1;  // $1000-$1FFF
+    uint8_t *chr_ram;          // $0000-$1FFF, only used when the cartridge has no CHR ROM
     uint8_t *name_table_0;     // $2000-$23BF
     uint8_t *name_table_1;     // $2400-$27FF
     uint8_t *name_table_2;     // $2800-$2BFF
     uint8_t *name_table_3;     // $2C00-$2FFF
     uint8_t *palette;          // $3F00-$3F1F
+    uint8_t *name_tables[4];   // $2000-$2FFF in 1K slots, rebuilt by set_mirror_mode
+
+    // BANK WINDOWS
+    uint8_t *prg_windows[4];   // $8000-$FFFF in 8K slots, pointing into PRG ROM
+    uint8_t *chr_windows[8];   // $0000-$1FFF in 1K slots, pointing into CHR ROM/RAM
+    bool chr_writable;
+
+    // DECODED CHR
+    uint64_t *chr_rows;          // 512 tiles x 8 rows of the mapped CHR, one pixel (0-3) per byte, leftmost first
+    uint64_t *chr_rows_flipped;  // the same rows mirrored horizontally
+    bool *chr_tile_valid;        // cleared when a tile's window is switched or its CHR RAM written
+
+    // PAGE TABLES
+    uint8_t *cpu_read_pages[0x100];   // direct memory for each 256 byte cpu page, NULL for pages with side effects
+    uint8_t *cpu_write_pages[0x100];
 
     // DEVICES
     Mapper *mapper;
@@ -29,7 +44,10 @@ typedef struct Bus {
     struct Controller *controller_2;
 
     // SYSTEM STATUS
-    uint32_t system_cycles;
+    uint64_t system_cycles;     // ppu cycles run so far
+    uint64_t cpu_clock;         // ppu cycle of the cpu's next bus access
+    uint64_t ppu_deadline;      // the ppu cannot raise an nmi before this cycle
+    bool irq_pending;
     bool a12_state_previous;
     bool a12_state_current;
 
@@ -37,16 +55,119 @@ typedef struct Bus {
     int poll_input2;
 
 } Bus;
-#endif
 
-void cpu_write_to_bus(Bus *bus, uint16_t address, uint8_t value);
+/**
+ * @brief cpu write to a page without direct memory (I/O, mapper registers)
+ *
+ * @param bus
+ * @param address
+ * @param value
+ */
+void cpu_write_to_io(Bus *bus, uint16_t address, uint8_t value);
+
+/**
+ * @brief cpu read from a page without direct memory (I/O, mapper registers)
+ *
+ * @param bus
+ * @param address
+ * @return uint8_t
+ */
+uint8_t cpu_read_from_io(Bus *bus, uint16_t address);
+
+/**
+ * @brief point a range of cpu pages directly at memory
+ *
+ * @param bus
+ * @param address start of the range, page aligned
+ * @param size size of the range, a multiple of 256
+ * @param read memory to read from, NULL to read through cpu_read_from_io
+ * @param write memory to write to, NULL to write through cpu_write_to_io
+ */
+void map_cpu_pages(Bus *bus, uint16_t address, uint32_t size, uint8_t *read, uint8_t *write);
+
+static inline void cpu_write_to_bus(Bus *bus, uint16_t address, uint8_t value) {
+    COUNT(cpu_writes[address >> 13]);
+    uint8_t *page = bus->cpu_write_pages[address >> 8];
+    if (page)
+        page[address & 0xff] = value;
+    else
+        cpu_write_to_io(bus, address, value);
+}
+
+static inline uint8_t cpu_read_from_bus(Bus *bus, uint16_t address) {
+    COUNT(cpu_reads[address >> 13]);
+    uint8_t *page = bus->cpu_read_pages[address >> 8];
+    if (page)
+        return page[address & 0xff];
+    return cpu_read_from_io(bus, address);
+}
 
-uint8_t cpu_read_from_bus(Bus *bus, uint16_t address);
+/**
+ * @brief point a 1K CHR window at memory, dropping its decoded tiles if it moved
+ *
+ * @param bus
+ * @param slot window number, $0000-$1FFF in 1K steps
+ * @param memory
+ */
+void map_chr_window(Bus *bus, uint8_t slot, uint8_t *memory);
+
+/**
+ * @brief expand the 8 rows of a mapped CHR tile into the decoded row caches
+ *
+ * @param bus
+ * @param tile tile number in the pattern tables, 0-511
+ */
+void decode_chr_tile(Bus *bus, uint16_t tile);
+
+/**
+ * @brief decoded pixels of one tile row, decoding the tile first if needed
+ *
+ * @param bus
+ * @param address ppu address of the row's low bitplane byte
+ * @param flipped mirror the row horizontally
+ * @return uint64_t
+ */
+static inline uint64_t chr_tile_row(Bus *bus, uint16_t address, bool flipped) {
+    uint16_t tile = (address >> 4) & 0x1ff;
+    if (!bus->chr_tile_valid[tile])
+        decode_chr_tile(bus, tile);
+
+    return (flipped ? bus->chr_rows_flipped : bus->chr_rows)[tile * 8 + (address & 0x7)];
+}
 
 void ppu_write_to_bus(Bus *bus, uint16_t address, uint8_t value);
 
 uint8_t ppu_read_from_bus(Bus *bus, uint16_t address);
 
-void clock_bus(Bus *bus, SDL_Window *window);
+/**
+ * @brief run the ppu up to (not including) the given cycle
+ *
+ * @param bus
+ * @param target
+ */
+void catch_up_ppu(Bus *bus, uint64_t target);
+
+/**
+ * @brief run the cpu for one instruction, catching the ppu up only when an interrupt could be due
+ *
+ * @param bus
+ */
+void clock_bus(Bus *bus);
 
-Bus *InitBus(void);
\ No newline at end of file
+/**
+ * @brief clock_bus with the cpu core passed in, to compare cores in one build
+ *
+ * @param bus
+ * @param step step_cpu_switch or step_cpu_table
+ */
+void clock_bus_with(Bus *bus, uint32_t (*step)(struct State6502 *cpu));
+
+/**
+ * @brief clock the system until the ppu finishes drawing a frame
+ *
+ * @param bus
+ */
+void run_frame(Bus *bus);
+
+Bus *InitBus(void);
+#endif
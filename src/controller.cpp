@@ -7,7 +7,7 @@
  * @return Controller* 
  */
 Controller *InitController() {
-    Controller *controller = (Controller *) malloc(sizeof(controller));
+    Controller *controller = (Controller *) malloc(sizeof(Controller));
     controller->left = false;
     controller->right = false;
     controller->up = false;
@@ -126,3 +126,34 @@ uint8_t read_from_controller(Controller *controller, uint8_t bit) {
     }
     return 0;
 }
+
+/**
+ * @brief controller state as a byte, one bit per button in the order they're read (bit 0 A ... bit 7 right)
+ *
+ * @param controller
+ * @return uint8_t
+ */
+uint8_t get_controller_buttons(Controller *controller) {
+    uint8_t buttons = 0;
+    for (int bit = 0; bit < 8; bit++)
+        buttons |= read_from_controller(controller, bit) << bit;
+
+    return buttons;
+}
+
+/**
+ * @brief set controller state from a byte made by get_controller_buttons
+ *
+ * @param controller
+ * @param buttons
+ */
+void set_controller_buttons(Controller *controller, uint8_t buttons) {
+    controller->a = buttons & 0x01;
+    controller->b = buttons & 0x02;
+    controller->select = buttons & 0x04;
+    controller->start = buttons & 0x08;
+    controller->up = buttons & 0x10;
+    controller->down = buttons & 0x20;
+    controller->left = buttons & 0x40;
+    controller->right = buttons & 0x80;
+}
@@ -47,3 +47,18 @@ void set_controller(Controller *controller, uint8_t *pressed_keys);
  */
 uint8_t read_from_controller(Controller *controller, uint8_t bit);
 
+/**
+ * @brief controller state as a byte, one bit per button in the order they're read (bit 0 A ... bit 7 right)
+ *
+ * @param controller
+ * @return uint8_t
+ */
+uint8_t get_controller_buttons(Controller *controller);
+
+/**
+ * @brief set controller state from a byte made by get_controller_buttons
+ *
+ * @param controller
+ * @param buttons
+ */
+void set_controller_buttons(Controller *controller, uint8_t buttons);
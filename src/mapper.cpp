@@ -1,11 +1,181 @@
 #include <stdio.h>
+#include <string.h>
 #include "mapper.hpp"
 
+#include "2C02.h"
+#include "6502.h"
+#include "bus.hpp"
+#include "controller.h"
+#include "mapper_0.hpp"
+#include "mapper_1.hpp"
+#include "mapper_2.hpp"
+#include "mapper_3.hpp"
+#include "mapper_4.hpp"
+#include "mapper_76.hpp"
+#include "movie.h"
+#include "savestate.h"
+
 Mapper::Mapper(char *game, uint8_t mapper_number, uint8_t *buffer, Bus *bus) {
     this->game = (char *) malloc(sizeof(char) * 200);
     this->game = game;
     this->mapper_number = mapper_number;
     this->allow_cpu_writes = true;
+    this->watches_a12 = false;
     this->buffer = buffer;
     this->bus = bus;
+
+    // locate the rom banks once, bank switches then only move window pointers
+    this->prg_rom = buffer + 0x10;
+    this->prg_rom_size = buffer[4] * 0x4000;
+
+    if (buffer[5] > 0) {
+        this->chr_memory = this->prg_rom + this->prg_rom_size;
+        this->chr_memory_size = buffer[5] * 0x2000;
+        bus->chr_writable = false;
+    }
+
+    else {
+        this->chr_memory = bus->chr_ram;
+        this->chr_memory_size = 0x2000;
+        bus->chr_writable = true;
+    }
+}
+
+void Mapper::map_prg_bank(uint16_t address, uint32_t bank, uint32_t size) {
+    COUNT(prg_bank_switches);
+    uint32_t bank_start = (bank * size) % this->prg_rom_size;
+    for (uint32_t offset = 0; offset < size; offset += 0x2000) {
+        uint8_t **window = &this->bus->prg_windows[((address + offset) >> 13) & 0x3];
+        if (*window != this->prg_rom + bank_start + offset)
+            COUNT_BY(prg_bytes_remapped, 0x2000);
+        *window = this->prg_rom + bank_start + offset;
+    }
+
+    // rom is read only, writes still reach handle_write
+    map_cpu_pages(this->bus, address, size, this->prg_rom + bank_start, NULL);
+}
+
+void Mapper::map_chr_bank(uint16_t address, uint32_t bank, uint32_t size) {
+    COUNT(chr_bank_switches);
+    uint32_t bank_start = (bank * size) % this->chr_memory_size;
+    for (uint32_t offset = 0; offset < size; offset += 0x400) {
+        map_chr_window(this->bus, ((address + offset) >> 10) & 0x7, this->chr_memory + bank_start + offset);
+    }
+}
+
+void Mapper::serialize(SaveState *state) {
+    // windows are saved as offsets into the rom (or chr ram), which covers every mapper's banking
+    for (int slot = 0; slot < 4; slot++)
+        save_u32(state, this->bus->prg_windows[slot] - this->prg_rom);
+    for (int slot = 0; slot < 8; slot++)
+        save_u32(state, this->bus->chr_windows[slot] - this->chr_memory);
+}
+
+void Mapper::deserialize(SaveState *state) {
+    for (int slot = 0; slot < 4; slot++) {
+        uint8_t *window = this->prg_rom + load_u32(state) % this->prg_rom_size;
+        this->bus->prg_windows[slot] = window;
+        map_cpu_pages(this->bus, 0x8000 + slot * 0x2000, 0x2000, window, NULL);
+    }
+
+    for (int slot = 0; slot < 8; slot++)
+        map_chr_window(this->bus, slot, this->chr_memory + load_u32(state) % this->chr_memory_size);
+}
+
+/************************ MACHINE ************************/
+
+/**
+ * @brief load a rom and build the machine that runs it: bus, cpu, ppu, both controllers and the rom's mapper,
+ * with the cpu reset
+ *
+ * @param rom_path
+ * @param rom_crc if not NULL, set to the crc32 of the rom's prg and chr data
+ * @return Bus* NULL if the rom can't be read or its mapper isn't supported
+ */
+Bus *InitMachine(char *rom_path, uint32_t *rom_crc) {
+    // load the rom into a buffer, which the mapper keeps
+    FILE *rom = fopen(rom_path, "rb");
+    if (!rom)
+        return NULL;
+
+    fseek(rom, 0, SEEK_END);
+    int file_size = ftell(rom);
+    fseek(rom, 0, SEEK_SET);
+
+    uint8_t *buffer = (uint8_t *)malloc(file_size + 1);
+    if (!buffer || file_size < 16 || fread(buffer, file_size, 1, rom) != 1) {
+        free(buffer);
+        fclose(rom);
+        return NULL;
+    }
+    fclose(rom);
+
+    if (rom_crc)
+        *rom_crc = rom_crc32(buffer + 16, file_size - 16);
+
+    // the game's name is the rom's path without the extension, save files are named after it
+    char *game = (char *)malloc(sizeof(char) * 200);
+    strcpy(game, rom_path);
+    game[strlen(rom_path) - 4] = '\0';
+
+    // create the devices and connect them to the bus
+    Bus *bus = InitBus();
+    State6502 *cpu = Init6502();
+    State2C02 *ppu = Init2C02();
+    Controller *controller_1 = InitController();
+    Controller *controller_2 = InitController();
+
+    cpu->bus = bus;
+    ppu->bus = bus;
+    controller_1->bus = bus;
+    controller_2->bus = bus;
+    bus->cpu = cpu;
+    bus->ppu = ppu;
+    bus->controller_1 = controller_1;
+    bus->controller_2 = controller_2;
+
+    // get the right mapper
+    Mapper *mapper;
+    uint16_t mapper_number = (buffer[7] & 0xf0) | (buffer[6] >> 0x4);
+    switch (mapper_number) {
+        case 0:
+            // NROM
+            mapper = new Mapper_0(game, mapper_number, buffer, bus);
+            break;
+
+        case 1:
+            // MMC1
+            mapper = new Mapper_1(game, mapper_number, buffer, bus);
+            break;
+
+        case 2:
+            // UNROM
+            mapper = new Mapper_2(game, mapper_number, buffer, bus);
+            break;
+
+        case 3:
+            // CNROM
+            mapper = new Mapper_3(game, mapper_number, buffer, bus);
+            break;
+
+        case 4:
+            // MMC3
+            mapper = new Mapper_4(game, mapper_number, buffer, bus);
+            break;
+
+        case 76:
+            // Mapper 076
+            mapper = new Mapper_76(game, mapper_number, buffer, bus);
+            break;
+
+        default:
+            return NULL;
+    }
+
+    // initialize addressable space
+    bus->mapper = mapper;
+    mapper->initialize();
+    reset(cpu);
+
+    return bus;
 }
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 struct Bus;
+struct SaveState;
 
 #ifndef MAPPER_HPP
 #define MAPPER_HPP
@@ -19,10 +20,16 @@ class Mapper {
         uint16_t chr_bank_size;
 
         bool allow_cpu_writes;
-        bool chr_bank_switch;
+        bool watches_a12;           // needs check_a12_rising_edge every ppu cycle
 
         uint8_t *buffer;
 
+        // BANK WINDOWS
+        uint8_t *prg_rom;
+        uint8_t *chr_memory;        // CHR ROM, or the bus CHR RAM if the cartridge has none
+        uint32_t prg_rom_size;
+        uint32_t chr_memory_size;
+
         Bus *bus;
 
         Mapper() = default;
@@ -31,6 +38,48 @@ class Mapper {
         virtual void handle_write(uint16_t address, uint8_t value) {};
         virtual void check_a12_rising_edge() {};
         virtual void cleanup() {};
-        
+
+        /**
+         * @brief append the mapper's state to a save state: the bank windows here, registers in subclasses
+         *
+         * @param state
+         */
+        virtual void serialize(SaveState *state);
+
+        /**
+         * @brief restore what serialize saved
+         *
+         * @param state
+         */
+        virtual void deserialize(SaveState *state);
+
+        /**
+         * @brief point the 8K PRG windows covering address..address+size at a bank of PRG ROM
+         *
+         * @param address cpu address of the window, $8000-$FFFF
+         * @param bank bank number in units of size
+         * @param size bank size, a multiple of 8K
+         */
+        void map_prg_bank(uint16_t address, uint32_t bank, uint32_t size);
+
+        /**
+         * @brief point the 1K CHR windows covering address..address+size at a bank of CHR ROM/RAM
+         *
+         * @param address ppu address of the window, $0000-$1FFF
+         * @param bank bank number in units of size
+         * @param size bank size, a multiple of 1K
+         */
+        void map_chr_bank(uint16_t address, uint32_t bank, uint32_t size);
+
 };
+
+/**
+ * @brief load a rom and build the machine that runs it: bus, cpu, ppu, both controllers and the rom's mapper,
+ * with the cpu reset
+ *
+ * @param rom_path
+ * @param rom_crc if not NULL, set to the crc32 of the rom's prg and chr data
+ * @return Bus* NULL if the rom can't be read or its mapper isn't supported
+ */
+Bus *InitMachine(char *rom_path, uint32_t *rom_crc);
 #endif
\ No newline at end of file
@@ -9,20 +9,15 @@ void Mapper_0::initialize() {
     this->num_prg_banks = this->buffer[4];
     this->num_chr_banks = this->buffer[5];
 
-    // LOAD PROGRAM ROM
-    uint16_t prg_rom_start = (num_prg_banks == 2) ? 0x8000 : 0xc000;
-    for (int i = 0; i < prg_bank_size * buffer[4]; i++) {
-        cpu_write_to_bus(bus, prg_rom_start + i, buffer[i + 0x10]);  
-    }
+    // LOAD PROGRAM ROM (a single 16K bank is mirrored into both windows)
+    map_prg_bank(0x8000, 0, prg_bank_size);
+    map_prg_bank(0xc000, num_prg_banks - 1, prg_bank_size);
 
     allow_cpu_writes = false;
     
 
     // LOAD CHR ROM
-    uint16_t address_offset = prg_bank_size * buffer[4] + 0x10;
-    for (int i = 0; i < chr_bank_size * buffer[5]; i++) {
-        ppu_write_to_bus(bus, i, buffer[i + address_offset]);
-    }
+    map_chr_bank(0x0000, 0, chr_bank_size);
 
     // set mirroring
     set_mirror_mode(bus->ppu, buffer[6] & 0x1);
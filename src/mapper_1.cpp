@@ -2,6 +2,7 @@
 
 #include "2C02.h"
 #include "bus.hpp"
+#include "savestate.h"
 
 void Mapper_1::initialize() {
     // set prg/chr size/number of banks
@@ -10,16 +11,16 @@ void Mapper_1::initialize() {
     this->num_prg_banks = this->buffer[4];
     this->num_chr_banks = this->buffer[5];
 
-    // load program rom
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0x8000 + i, this->buffer[0x10 + i]);
-    }
+    // power on in 16K mode with the last bank fixed at $C000
+    this->load = 0;
+    this->load_counter = 0;
+    this->control.reg = 0x0c;
+    this->chr_bank_0 = 0;
+    this->chr_bank_1 = 1;
+    this->prg_bank.reg = 0;
 
-    // initialize second 16K window to the last 16K bank (fixed)
-    uint32_t last_bank_start = ((num_prg_banks - 1) * prg_bank_size) + 0x10;
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0xc000 + i, this->buffer[last_bank_start + i]);
-    }
+    // load program rom
+    switch_prg_bank();
 
     // LOAD SAVE
     const size_t start_index = 0x1FE0;
@@ -49,16 +50,12 @@ void Mapper_1::initialize() {
 
     allow_cpu_writes = false;
 
+    // prg ram at $6000-$7FFF is plain memory
+    map_cpu_pages(bus, 0x6000, 0x2000, bus->unmapped + start_index, bus->unmapped + start_index);
+
 
     // LOAD CHR ROM
-    this->chr_bank_switch = true;
-    if (this->num_chr_banks > 0) {
-        uint16_t address_offset = prg_bank_size * this->prg_bank_size + 0x10;
-        for (int i = 0; i < chr_bank_size; i++) {
-            ppu_write_to_bus(bus, i, buffer[i + address_offset]);
-        }
-    }
-    this->chr_bank_switch = false;
+    map_chr_bank(0x0000, 0, chr_bank_size);
 
     // set mirroring
     set_mirror_mode(bus->ppu, buffer[6] & 0x1);
@@ -96,19 +93,20 @@ void Mapper_1::handle_write(uint16_t address, uint8_t value) {
                 this->prg_bank_size = (this->control.prg_bank_mode <= 1) ? 0x8000 : 0x4000;
                 this->chr_bank_size = this->control.chr_bank_mode ? 0x1000 : 0x2000;
 
+                // remap the windows for the new bank modes
+                switch_prg_bank();
+                switch_chr_bank();
             }
 
             else if (address <= 0xbfff) {
                 // chr bank 0 register
                 this->chr_bank_0 = this->load;
-                this->chr_bank_to_switch = 0;
                 switch_chr_bank();
             }
 
             else if (address <= 0xdfff) {
                 // chr bank 1 register
                 this->chr_bank_1 = this->load;
-                this->chr_bank_to_switch = 1;
                 switch_chr_bank();
             }
 
@@ -127,30 +125,14 @@ void Mapper_1::handle_write(uint16_t address, uint8_t value) {
 void Mapper_1::switch_chr_bank() {
     if (this->num_chr_banks > 0) {
         if (this->control.chr_bank_mode == 0) {
-            // switch entire 8K window
-            uint32_t address_offset = 0x4000 * this->num_prg_banks + 0x10;
-            uint32_t bank_start = address_offset + (this->chr_bank_0 & 0x1e) * this->chr_bank_size;
-            for (int i = 0; i < this->chr_bank_size; i++) {
-                ppu_write_to_bus(bus, i, this->buffer[bank_start + i]);
-            }
+            // switch entire 8K window, low bit of the bank number is ignored
+            map_chr_bank(0x0000, this->chr_bank_0 >> 1, 0x2000);
         }
 
         else {
             // switch the 4K windows
-            uint32_t address_offset = 0x4000 * this->num_prg_banks + 0x10;
-            if (this->chr_bank_to_switch == 0) {
-                uint32_t bank_0_start = address_offset + this->chr_bank_size * (this->chr_bank_0);
-                for (int i = 0; i < this->chr_bank_size; i++) {
-                    ppu_write_to_bus(bus, i, this->buffer[bank_0_start + i]);
-                }
-            }
-
-            else {
-                uint32_t bank_1_start = address_offset + this->chr_bank_size * (this->chr_bank_1);
-                for (int i = 0; i < this->chr_bank_size; i++) {
-                    ppu_write_to_bus(bus, this->chr_bank_size + i, this->buffer[bank_1_start + i]);
-                }
-            }
+            map_chr_bank(0x0000, this->chr_bank_0, 0x1000);
+            map_chr_bank(0x1000, this->chr_bank_1, 0x1000);
         }
     }
 }
@@ -158,44 +140,19 @@ void Mapper_1::switch_chr_bank() {
 void Mapper_1::switch_prg_bank() {
     if (this->control.prg_bank_mode <= 1) {
         // switch entire 32K window
-        uint32_t bank_start = (this->prg_bank.bank_select >> 1) * 0x8000 + 0x10;
-        this->allow_cpu_writes = true;
-        for (int i = 0; i < 0x8000; i++) {
-            cpu_write_to_bus(bus, 0x8000 + i, this->buffer[bank_start + i]);
-        }
-        this->allow_cpu_writes = false;
+        map_prg_bank(0x8000, this->prg_bank.bank_select >> 1, 0x8000);
     }
 
     else if (this->control.prg_bank_mode == 2) {
         // fix first bank, switch last bank
-        this->allow_cpu_writes = true;
-        for (int i = 0; i < 0x4000; i++) {
-            cpu_write_to_bus(bus, 0x8000 + i, this->buffer[0x10 + i]);
-        }
-
-        uint32_t bank_start = (this->prg_bank.bank_select) * 0x4000 + 0x10;
-        for (int i = 0; i < 0x4000; i++) {
-            cpu_write_to_bus(bus, 0xc000 + i, this->buffer[bank_start + i]);
-        }
-
-        this->allow_cpu_writes = false;
-
+        map_prg_bank(0x8000, 0, 0x4000);
+        map_prg_bank(0xc000, this->prg_bank.bank_select, 0x4000);
     }
 
     else {
         // switch first bank, fix last bank
-        uint32_t bank_start = (this->prg_bank.bank_select) * 0x4000 + 0x10;
-        this->allow_cpu_writes = true;
-        for (int i = 0; i < 0x4000; i++) {
-            cpu_write_to_bus(bus, 0x8000 + i, this->buffer[bank_start + i]);
-        }
-
-        bank_start = ((num_prg_banks - 1) * 0x4000) + 0x10;
-        for (int i = 0; i < 0x4000; i++) {
-            cpu_write_to_bus(bus, 0xc000 + i, this->buffer[bank_start + i]);
-        }
-
-        this->allow_cpu_writes = false;
+        map_prg_bank(0x8000, this->prg_bank.bank_select, 0x4000);
+        map_prg_bank(0xc000, this->num_prg_banks - 1, 0x4000);
     }
 }
 
@@ -225,3 +182,29 @@ void Mapper_1::cleanup() {
     // Close the file
     fclose(file);
 }
+
+void Mapper_1::serialize(SaveState *state) {
+    Mapper::serialize(state);
+
+    save_u8(state, this->load_counter);
+    save_u8(state, this->load);
+    save_u8(state, this->control.reg);
+    save_u8(state, this->chr_bank_0);
+    save_u8(state, this->chr_bank_1);
+    save_u8(state, this->prg_bank.reg);
+    save_u16(state, this->prg_bank_size);
+    save_u16(state, this->chr_bank_size);
+}
+
+void Mapper_1::deserialize(SaveState *state) {
+    Mapper::deserialize(state);
+
+    this->load_counter = load_u8(state);
+    this->load = load_u8(state);
+    this->control.reg = load_u8(state);
+    this->chr_bank_0 = load_u8(state);
+    this->chr_bank_1 = load_u8(state);
+    this->prg_bank.reg = load_u8(state);
+    this->prg_bank_size = load_u16(state);
+    this->chr_bank_size = load_u16(state);
+}
@@ -20,7 +20,6 @@ class Mapper_1 : public Mapper {
     } control;
     uint8_t chr_bank_0 : 5;
     uint8_t chr_bank_1 : 5;
-    bool chr_bank_to_switch;
     union prg_bank {
         struct {
             uint8_t bank_select : 4;
@@ -35,4 +34,6 @@ class Mapper_1 : public Mapper {
     void switch_prg_bank();
     void switch_chr_bank();
     void cleanup() override;
+    void serialize(SaveState *state) override;
+    void deserialize(SaveState *state) override;
 };
\ No newline at end of file
@@ -10,22 +10,14 @@ void Mapper_2 ::initialize() {
     this->num_chr_banks = this->buffer[5];
 
     // LOAD PROGRAM ROM
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0x8000 + i, this->buffer[0x10 + i]);
-    }
+    map_prg_bank(0x8000, 0, prg_bank_size);
 
     // initialize second 16K window to the last 16K bank (fixed)
-    uint32_t last_bank_start = ((num_prg_banks - 1) * prg_bank_size) + 0x10;
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0xc000 + i, this->buffer[last_bank_start + i]);
-    }
+    map_prg_bank(0xc000, num_prg_banks - 1, prg_bank_size);
     allow_cpu_writes = false;
 
     // LOAD CHR ROM
-    uint16_t address_offset = prg_bank_size * buffer[4] + 0x10;
-    for (int i = 0; i < chr_bank_size * buffer[5]; i++) {
-        ppu_write_to_bus(bus, i, buffer[i + address_offset]);
-    }
+    map_chr_bank(0x0000, 0, chr_bank_size);
 
     // set mirroring
     set_mirror_mode(bus->ppu, buffer[6]);
@@ -39,10 +31,5 @@ void Mapper_2::handle_write(uint16_t address, uint8_t value) {
 }
 
 void Mapper_2::switch_prg_bank(uint8_t prg_bank_number) {
-    uint32_t bank_start = (prg_bank_number) * prg_bank_size + 0x10;
-    this->allow_cpu_writes = true;
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0x8000 + i, this->buffer[bank_start + i]);
-    }
-    this->allow_cpu_writes = false;
+    map_prg_bank(0x8000, prg_bank_number, prg_bank_size);
 }
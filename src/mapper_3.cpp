@@ -9,19 +9,14 @@ void Mapper_3::initialize() {
     this->num_prg_banks = this->buffer[4];
     this->num_chr_banks = this->buffer[5];
 
-    // LOAD PROGRAM ROM
-    uint16_t prg_rom_start = (this->num_prg_banks == 2) ? 0x8000 : 0xc000;
-    for (int i = 0; i < this->prg_bank_size * this->num_prg_banks; i++) {
-        cpu_write_to_bus(bus, prg_rom_start + i, this->buffer[i + 0x10]);
-    }
+    // LOAD PROGRAM ROM (a single 16K bank is mirrored into both windows)
+    map_prg_bank(0x8000, 0, this->prg_bank_size);
+    map_prg_bank(0xc000, this->num_prg_banks - 1, this->prg_bank_size);
 
     this->allow_cpu_writes = false;
 
     // LOAD CHR ROM
-    uint16_t address_offset = 0x4000 * this->num_prg_banks + 0x10;
-    for (int i = 0; i < 0x2000; i++) {
-        ppu_write_to_bus(bus, i, this->buffer[i + address_offset]);
-    }
+    map_chr_bank(0x0000, 0, this->chr_bank_size);
 
     // set mirroring
     set_mirror_mode(bus->ppu, this->buffer[6]);
@@ -36,10 +31,6 @@ void Mapper_3::handle_write(uint16_t address, uint8_t value) {
 
 void Mapper_3::switch_chr_bank(uint8_t chr_bank_number) {
     // switch character rom bank
-    uint16_t address_offset = prg_bank_size * this->buffer[4] + 0x10;
-    uint32_t bank_start = address_offset + (chr_bank_number)*chr_bank_size;
-    for (int i = 0; i < chr_bank_size; i++) {
-        ppu_write_to_bus(bus, i, this->buffer[bank_start + i]);
-    }
+    map_chr_bank(0x0000, chr_bank_number, chr_bank_size);
 }
 
@@ -3,6 +3,7 @@
 #include "2C02.h"
 #include "6502.h"
 #include "bus.hpp"
+#include "savestate.h"
 
 void Mapper_4::initialize() {
     // set prg/chr size/number of banks
@@ -11,16 +12,31 @@ void Mapper_4::initialize() {
     this->num_prg_banks = this->buffer[4];
     this->num_chr_banks = this->buffer[5];
 
-    // load program rom
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0x8000 + i, this->buffer[0x10 + i]);
-    }
+    // the irq counter is clocked by ppu address line 12
+    this->watches_a12 = true;
+
+    // power on with the first 16K at $8000 and the first 8K of CHR, and the irq counter stopped
+    this->mirroring = 0;
+    this->prg_ram_protect = 0;
+    this->irq_counter = 0;
+    this->irq_latch = 0;
+    this->irq_reload = 0;
+    this->irq_disable = 0;
+    this->irq_enable = 0;
+    this->a12_low_counter = 0;
+    this->fire_irq = false;
+    this->bank_select.reg = 0;
+    this->bank_registers[0] = 0;
+    this->bank_registers[1] = 2;
+    this->bank_registers[2] = 4;
+    this->bank_registers[3] = 5;
+    this->bank_registers[4] = 6;
+    this->bank_registers[5] = 7;
+    this->bank_registers[6] = 0;
+    this->bank_registers[7] = 1;
 
-    // initialize second 16K window to the last 16K bank (fixed)
-    uint32_t last_bank_start = ((num_prg_banks - 1) * prg_bank_size) + 0x10;
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0xc000 + i, this->buffer[last_bank_start + i]);
-    }
+    // load program rom
+    this->switch_prg_bank();
 
     // LOAD SAVE
     const size_t start_index = 0x1FE0;
@@ -50,15 +66,11 @@ void Mapper_4::initialize() {
 
     allow_cpu_writes = false;
 
+    // prg ram at $6000-$7FFF is plain memory
+    map_cpu_pages(bus, 0x6000, 0x2000, bus->unmapped + start_index, bus->unmapped + start_index);
+
     // LOAD CHR ROM
-    this->chr_bank_switch = true;
-    if (this->num_chr_banks > 0) {
-        uint32_t chr_bank_start = this->prg_bank_size * this->num_prg_banks + 0x10;
-        for (int i = 0; i < chr_bank_size; i++) {
-            ppu_write_to_bus(bus, i, buffer[i + chr_bank_start]);
-        }
-    }
-    this->chr_bank_switch = false;
+    this->switch_chr_bank();
 }
 
 void Mapper_4::handle_write(uint16_t address, uint8_t value) {
@@ -71,11 +83,12 @@ void Mapper_4::handle_write(uint16_t address, uint8_t value) {
     if (address >= 0x8000 && address <= 0x9fff) {
         if (address % 2 == 0)
             this->bank_select.reg = value;
-        else {
-            this->bank_number = value;
-            this->switch_chr_bank();
-            this->switch_prg_bank();
-        }
+        else
+            this->bank_registers[this->bank_select.index] = value;
+
+        // bank modes and numbers both take effect immediately
+        this->switch_chr_bank();
+        this->switch_prg_bank();
     }
 
     else if (address >= 0xA000 && address <= 0xBFFF) {
@@ -105,116 +118,36 @@ void Mapper_4::handle_write(uint16_t address, uint8_t value) {
 }
 
 void Mapper_4::switch_chr_bank() {
-    uint16_t address = (0x1000 * this->bank_select.chr_inversion);
-    uint16_t bank_size = 0;
-    switch (this->bank_select.index) {
-        case 0:
-            address += 0;
-            bank_size = 0x800;
-            this->bank_number &= 0xfe;
-            break;
-
-        case 1:
-            address += 0x800;
-            bank_size = 0x800;
-            this->bank_number &= 0xfe;
-            break;
-
-        case 2:
-            address += 0x1000;
-            bank_size = 0x400;
-            break;
-
-        case 3:
-            address += 0x1400;
-            bank_size = 0x400;
-            break;
-
-        case 4:
-            address += 0x1800;
-            bank_size = 0x400;
-            break;
-
-        case 5:
-            address += 0x1c00;
-            bank_size = 0x400;
-            break;
-
-        default:
-            return;
-    }
-
-    address %= 0x2000;
-    uint32_t bank_start = (0x400 * this->bank_number) + (this->prg_bank_size * this->num_prg_banks) + 0x10;
-
-    this->chr_bank_switch = true;
-    for (int i = 0; i < bank_size; i++) {
-        ppu_write_to_bus(bus, address + i, this->buffer[bank_start + i]);
-    }
-    this->chr_bank_switch = false;
+    // R0/R1 select 2K banks (low bit ignored), R2-R5 select 1K banks.
+    // chr inversion swaps the 2K and 1K halves of the pattern tables
+    uint16_t inversion = 0x1000 * this->bank_select.chr_inversion;
+
+    map_chr_bank(0x0000 ^ inversion, this->bank_registers[0] >> 1, 0x800);
+    map_chr_bank(0x0800 ^ inversion, this->bank_registers[1] >> 1, 0x800);
+    map_chr_bank(0x1000 ^ inversion, this->bank_registers[2], 0x400);
+    map_chr_bank(0x1400 ^ inversion, this->bank_registers[3], 0x400);
+    map_chr_bank(0x1800 ^ inversion, this->bank_registers[4], 0x400);
+    map_chr_bank(0x1c00 ^ inversion, this->bank_registers[5], 0x400);
 }
 
 void Mapper_4::switch_prg_bank() {
-    if (this->bank_select.index > 5) {
-        this->allow_cpu_writes = true;
-        this->bank_number &= 0x3f;
-        uint32_t bank_start;
-        if (this->bank_select.prg_bank_mode == 0) {
-            if (this->bank_select.index == 6) {
-                // swap $8000-$9FFF
-                bank_start = 0x10 + (this->bank_number * 0x2000);
-                for (int i = 0; i < 0x2000; i++) {
-                    cpu_write_to_bus(bus, 0x8000 + i, buffer[bank_start + i]);
-                }
-            }
-
-            else {
-                // swap $A000-$BFFF
-                bank_start = 0x10 + (this->bank_number * 0x2000);
-                for (int i = 0; i < 0x2000; i++) {
-                    cpu_write_to_bus(bus, 0xA000 + i, buffer[bank_start + i]);
-                }
-            }
-
-            // set $C000-$DFFF to second to last bank, $E000-$FFFF to last bank
-            bank_start = 0x10 + (this->prg_bank_size * (this->num_prg_banks - 1));
-            for (int i = 0; i < 0x4000; i++) {
-                cpu_write_to_bus(bus, 0xc000 + i, buffer[bank_start + i]);
-            }
+    uint32_t second_last_bank = this->num_prg_banks * 2 - 2;
 
-        }
+    if (this->bank_select.prg_bank_mode == 0) {
+        // R6 at $8000-$9FFF, second to last bank at $C000-$DFFF
+        map_prg_bank(0x8000, this->bank_registers[6] & 0x3f, 0x2000);
+        map_prg_bank(0xc000, second_last_bank, 0x2000);
+    }
 
-        else {
-            if (this->bank_select.index == 6) {
-                // swap $C000-$DFFF
-                bank_start = 0x10 + (this->bank_number * 0x2000);
-                for (int i = 0; i < 0x2000; i++) {
-                    cpu_write_to_bus(bus, 0xC000 + i, buffer[bank_start + i]);
-                }
-
-            }
-
-            else {
-                // swap $A000-$BFFF
-                bank_start = 0x10 + (this->bank_number * 0x2000);
-                for (int i = 0; i < 0x2000; i++) {
-                    cpu_write_to_bus(bus, 0xA000 + i, buffer[bank_start + i]);
-                }
-            }
-
-            // set $8000-$9FFF to second to last bank, $E000-$FFFF to last bank
-            bank_start = 0x10 + (this->prg_bank_size) * (this->num_prg_banks - 1);
-            for (int i = 0; i < 0x2000; i++) {
-                cpu_write_to_bus(bus, 0x8000 + i, buffer[bank_start + i]);
-            }
-
-            bank_start = 0x10 + (this->prg_bank_size) * (this->num_prg_banks - 1) + 0x2000;
-            for (int i = 0; i < 0x2000; i++) {
-                cpu_write_to_bus(bus, 0xe000 + i, buffer[bank_start + i]);
-            }
-        }
-        this->allow_cpu_writes = false;
+    else {
+        // second to last bank at $8000-$9FFF, R6 at $C000-$DFFF
+        map_prg_bank(0x8000, second_last_bank, 0x2000);
+        map_prg_bank(0xc000, this->bank_registers[6] & 0x3f, 0x2000);
     }
+
+    // R7 at $A000-$BFFF, last bank fixed at $E000-$FFFF
+    map_prg_bank(0xa000, this->bank_registers[7] & 0x3f, 0x2000);
+    map_prg_bank(0xe000, second_last_bank + 1, 0x2000);
 }
 
 void Mapper_4::check_a12_rising_edge() {
@@ -230,7 +163,7 @@ void Mapper_4::check_a12_rising_edge() {
                 this->irq_counter--;
 
             if (this->irq_counter == 0 && this->irq_enable)
-                irq(this->bus->cpu);
+                this->bus->irq_pending = true;
         }
 
         this->a12_low_counter = 0;
@@ -262,4 +195,36 @@ void Mapper_4::cleanup() {
 
     // Close the file
     fclose(file);
+}
+
+void Mapper_4::serialize(SaveState *state) {
+    Mapper::serialize(state);
+
+    save_u8(state, this->bank_select.reg);
+    save_bytes(state, this->bank_registers, 8);
+    save_u8(state, this->mirroring);
+    save_u8(state, this->prg_ram_protect);
+    save_u8(state, this->irq_counter);
+    save_u8(state, this->irq_latch);
+    save_u8(state, this->irq_reload);
+    save_u8(state, this->irq_disable);
+    save_u8(state, this->irq_enable);
+    save_u32(state, this->a12_low_counter);
+    save_u8(state, this->fire_irq);
+}
+
+void Mapper_4::deserialize(SaveState *state) {
+    Mapper::deserialize(state);
+
+    this->bank_select.reg = load_u8(state);
+    load_bytes(state, this->bank_registers, 8);
+    this->mirroring = load_u8(state);
+    this->prg_ram_protect = load_u8(state);
+    this->irq_counter = load_u8(state);
+    this->irq_latch = load_u8(state);
+    this->irq_reload = load_u8(state);
+    this->irq_disable = load_u8(state);
+    this->irq_enable = load_u8(state);
+    this->a12_low_counter = (int32_t)load_u32(state);
+    this->fire_irq = load_u8(state);
 }
\ No newline at end of file
@@ -19,7 +19,7 @@ class Mapper_4 : public Mapper {
 
             uint8_t reg : 8;
         } bank_select;
-        uint8_t bank_number;
+        uint8_t bank_registers[8];
 
         uint8_t mirroring;
         uint8_t prg_ram_protect;
@@ -42,5 +42,7 @@ class Mapper_4 : public Mapper {
         void switch_chr_bank();
         void check_a12_rising_edge();
         void cleanup() override;
+        void serialize(SaveState *state) override;
+        void deserialize(SaveState *state) override;
 };
 
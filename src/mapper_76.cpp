@@ -1,6 +1,7 @@
 #include "mapper_76.hpp"
 
 #include "bus.hpp"
+#include "savestate.h"
 #include "2C02.h"
 
 void Mapper_76::initialize() {
@@ -14,29 +15,19 @@ void Mapper_76::initialize() {
     printf("CHR banks: %d\n", this->num_chr_banks);
     
 
-    this->allow_cpu_writes = true;
+    this->bank_address = 0;
+    this->data_port = 0;
+
     // load program rom
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0x8000 + i, this->buffer[0x10 + i]);
-    }
+    map_prg_bank(0x8000, 0, prg_bank_size);
 
     // initialize second 16K window to the last 16K bank (fixed)
-    uint32_t last_bank_start = ((num_prg_banks - 1) * prg_bank_size) + 0x10;
-    for (int i = 0; i < prg_bank_size; i++) {
-        cpu_write_to_bus(bus, 0xc000 + i, this->buffer[last_bank_start + i]);
-    }
+    map_prg_bank(0xc000, num_prg_banks - 1, prg_bank_size);
 
     this->allow_cpu_writes = false;
 
     // LOAD CHR ROM
-    this->chr_bank_switch = true;
-    if (this->num_chr_banks > 0) {
-        uint32_t chr_bank_start = this->prg_bank_size * this->num_prg_banks + 0x10;
-        for (int i = 0; i < chr_bank_size; i++) {
-            ppu_write_to_bus(bus, i, buffer[i + chr_bank_start]);
-        }
-    }
-    this->chr_bank_switch = false;
+    map_chr_bank(0x0000, 0, chr_bank_size);
 
     // set mirroring
     set_mirror_mode(bus->ppu, buffer[6] & 0x1);
@@ -56,7 +47,6 @@ void Mapper_76::handle_write(uint16_t address, uint8_t value) {
 }
 
 void Mapper_76::switch_chr_bank() {
-    uint32_t bank_start = 0x10 + this->prg_bank_size * this->num_prg_banks + (this->data_port * 0x800);
     uint16_t address;
     switch (this->bank_address) {
         case 2:
@@ -76,18 +66,13 @@ void Mapper_76::switch_chr_bank() {
             break;
 
         default:
-            break;
+            return;
     }
 
-    this->chr_bank_switch = true;
-    for (int i = 0; i < 0x800; i++) {
-        ppu_write_to_bus(bus, address + i, this->buffer[bank_start + i]);
-    }
-    this->chr_bank_switch = false;
+    map_chr_bank(address, this->data_port, 0x800);
 }
 
 void Mapper_76::switch_prg_bank() {
-    uint32_t bank_start = 0x10 + (((this->data_port)) * 0x2000);
     uint16_t address;
     switch (this->bank_address) {
         case 6:
@@ -99,16 +84,26 @@ void Mapper_76::switch_prg_bank() {
             break;
         
         default:
-            break;
+            return;
     }
 
-    this->allow_cpu_writes = true;
-    for (int i = 0; i < 0x2000; i++) {
-        cpu_write_to_bus(bus, address + i, buffer[bank_start + i]);
-    }
-    this->allow_cpu_writes = false;
+    map_prg_bank(address, this->data_port, 0x2000);
 }
 
 void Mapper_76::cleanup() {
 
+}
+
+void Mapper_76::serialize(SaveState *state) {
+    Mapper::serialize(state);
+
+    save_u8(state, this->bank_address);
+    save_u8(state, this->data_port);
+}
+
+void Mapper_76::deserialize(SaveState *state) {
+    Mapper::deserialize(state);
+
+    this->bank_address = load_u8(state);
+    this->data_port = load_u8(state);
 }
\ No newline at end of file
@@ -15,4 +15,6 @@ class Mapper_76 : public Mapper {
     void switch_prg_bank();
     void switch_chr_bank();
     void cleanup() override;
+    void serialize(SaveState *state) override;
+    void deserialize(SaveState *state) override;
 };
@@ -0,0 +1,195 @@
+#include "movie.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bus.hpp"
+#include "controller.h"
+
+/**
+ * @brief crc32 of a block of memory, used to tie a movie to a rom
+ *
+ * @param data
+ * @param size
+ * @return uint32_t
+ */
+uint32_t rom_crc32(const uint8_t *data, uint32_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+/**
+ * @brief creates an empty movie that starts from the machine as it is now
+ *
+ * @param bus
+ * @param rom_crc
+ * @return Movie*
+ */
+Movie *InitMovie(Bus *bus, uint32_t rom_crc) {
+    Movie *movie = (Movie *)malloc(sizeof(Movie));
+
+    movie->rom_crc = rom_crc;
+    movie->start = InitSaveState();
+    save_state(bus, movie->start);
+
+    movie->capacity = 60 * 60;
+    movie->inputs = (uint8_t *)malloc(2 * movie->capacity);
+    movie->frames = 0;
+    movie->position = 0;
+    movie->recording = true;
+
+    return movie;
+}
+
+/**
+ * @brief free a movie
+ *
+ * @param movie
+ */
+void free_movie(Movie *movie) {
+    free_save_state(movie->start);
+    free(movie->inputs);
+    free(movie);
+}
+
+/**
+ * @brief append both controllers' buttons as the next frame, call once before each run_frame
+ *
+ * @param movie
+ * @param bus
+ */
+void record_movie_frame(Movie *movie, Bus *bus) {
+    if (movie->frames == movie->capacity) {
+        movie->capacity *= 2;
+        movie->inputs = (uint8_t *)realloc(movie->inputs, 2 * movie->capacity);
+    }
+
+    uint8_t *input = &movie->inputs[2 * movie->frames];
+    input[0] = bus->controller_1 ? get_controller_buttons(bus->controller_1) : 0;
+    input[1] = bus->controller_2 ? get_controller_buttons(bus->controller_2) : 0;
+    movie->frames++;
+}
+
+/**
+ * @brief forget the last recorded frame, or play the last played one again, after a rewind_frame
+ *
+ * @param movie
+ */
+void rewind_movie_frame(Movie *movie) {
+    if (movie->recording && movie->frames > 0)
+        movie->frames--;
+    else if (!movie->recording && movie->position > 0)
+        movie->position--;
+}
+
+/**
+ * @brief put the machine back where the movie starts and play from its first frame
+ *
+ * @param movie
+ * @param bus
+ * @return bool false if the movie's state doesn't fit this rom
+ */
+bool start_movie(Movie *movie, Bus *bus) {
+    movie->position = 0;
+    return load_state(bus, movie->start);
+}
+
+/**
+ * @brief set both controllers from the next frame, call once before each run_frame
+ *
+ * @param movie
+ * @param bus
+ * @return bool false, with the controllers untouched, once every frame has been played
+ */
+bool play_movie_frame(Movie *movie, Bus *bus) {
+    if (movie->position >= movie->frames)
+        return false;
+
+    uint8_t *input = &movie->inputs[2 * movie->position++];
+    if (bus->controller_1)
+        set_controller_buttons(bus->controller_1, input[0]);
+    if (bus->controller_2)
+        set_controller_buttons(bus->controller_2, input[1]);
+
+    return true;
+}
+
+/************************ FILES ************************/
+
+/**
+ * @brief write a movie to a file
+ *
+ * @param movie
+ * @param path
+ * @return bool
+ */
+bool write_movie_file(Movie *movie, const char *path) {
+    SaveState *file = InitSaveState();
+
+    save_bytes(file, MOVIE_MAGIC, 8);
+    save_u32(file, MOVIE_VERSION);
+    save_u32(file, movie->rom_crc);
+    save_u32(file, movie->frames);
+    save_u32(file, movie->start->size);
+    save_bytes(file, movie->start->data, movie->start->size);
+    save_bytes(file, movie->inputs, 2 * movie->frames);
+
+    bool written = write_state_file(file, path);
+    free_save_state(file);
+
+    return written;
+}
+
+/**
+ * @brief read a movie from a file
+ *
+ * @param path
+ * @return Movie* NULL if the file can't be read or isn't a movie of this version
+ */
+Movie *read_movie_file(const char *path) {
+    SaveState *file = InitSaveState();
+    if (!read_state_file(file, path)) {
+        free_save_state(file);
+        return NULL;
+    }
+
+    file->position = 0;
+    file->error = false;
+
+    char magic[8];
+    load_bytes(file, magic, 8);
+    uint32_t version = load_u32(file);
+    uint32_t rom_crc = load_u32(file);
+    uint32_t frames = load_u32(file);
+    uint32_t state_size = load_u32(file);
+
+    // both sizes have to match what's left of the file
+    if (file->error || memcmp(magic, MOVIE_MAGIC, 8) != 0 || version != MOVIE_VERSION ||
+        (uint64_t)state_size + 2 * (uint64_t)frames != file->size - file->position) {
+        free_save_state(file);
+        return NULL;
+    }
+
+    Movie *movie = (Movie *)malloc(sizeof(Movie));
+    movie->rom_crc = rom_crc;
+    movie->start = InitSaveState();
+    movie->start->size = 0;
+    save_bytes(movie->start, &file->data[file->position], state_size);
+    file->position += state_size;
+
+    movie->capacity = frames > 0 ? frames : 1;
+    movie->inputs = (uint8_t *)malloc(2 * movie->capacity);
+    load_bytes(file, movie->inputs, 2 * frames);
+    movie->frames = frames;
+    movie->position = 0;
+    movie->recording = false;
+
+    free_save_state(file);
+    return movie;
+}
@@ -0,0 +1,100 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "savestate.h"
+
+#ifndef MOVIE_H
+#define MOVIE_H
+
+// a movie file starts with a header: the magic, the version, the crc32 of the rom's prg and chr data and the
+// number of frames. the save state the movie starts from follows (size first), then both controllers' buttons
+// for every frame, port 1 then port 2, as made by get_controller_buttons
+#define MOVIE_MAGIC "NESMOVIE"
+#define MOVIE_VERSION 1
+
+typedef struct Movie {
+    uint32_t rom_crc;
+    SaveState *start;   // the machine when recording started, usually right after power on
+    uint8_t *inputs;    // two bytes per frame
+    uint32_t frames;    // frames recorded
+    uint32_t capacity;  // frames allocated
+    uint32_t position;  // next frame to play back
+    bool recording;     // made by InitMovie rather than read from a file
+} Movie;
+
+/**
+ * @brief crc32 of a block of memory, used to tie a movie to a rom
+ *
+ * @param data
+ * @param size
+ * @return uint32_t
+ */
+uint32_t rom_crc32(const uint8_t *data, uint32_t size);
+
+/**
+ * @brief creates an empty movie that starts from the machine as it is now
+ *
+ * @param bus
+ * @param rom_crc
+ * @return Movie*
+ */
+Movie *InitMovie(struct Bus *bus, uint32_t rom_crc);
+
+/**
+ * @brief free a movie
+ *
+ * @param movie
+ */
+void free_movie(Movie *movie);
+
+/**
+ * @brief append both controllers' buttons as the next frame, call once before each run_frame
+ *
+ * @param movie
+ * @param bus
+ */
+void record_movie_frame(Movie *movie, struct Bus *bus);
+
+/**
+ * @brief forget the last recorded frame, or play the last played one again, after a rewind_frame
+ *
+ * @param movie
+ */
+void rewind_movie_frame(Movie *movie);
+
+/**
+ * @brief put the machine back where the movie starts and play from its first frame
+ *
+ * @param movie
+ * @param bus
+ * @return bool false if the movie's state doesn't fit this rom
+ */
+bool start_movie(Movie *movie, struct Bus *bus);
+
+/**
+ * @brief set both controllers from the next frame, call once before each run_frame
+ *
+ * @param movie
+ * @param bus
+ * @return bool false, with the controllers untouched, once every frame has been played
+ */
+bool play_movie_frame(Movie *movie, struct Bus *bus);
+
+/**
+ * @brief write a movie to a file
+ *
+ * @param movie
+ * @param path
+ * @return bool
+ */
+bool write_movie_file(Movie *movie, const char *path);
+
+/**
+ * @brief read a movie from a file
+ *
+ * @param path
+ * @return Movie* NULL if the file can't be read or isn't a movie of this version
+ */
+Movie *read_movie_file(const char *path);
+
+#endif
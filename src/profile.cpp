@@ -0,0 +1,96 @@
+#include "profile.h"
+
+#include <string.h>
+
+#include "Disassemble6502.h"
+
+Profile profile;
+
+/**
+ * @brief clear the times measured so far and measure the timer's own cost
+ */
+void reset_profile() {
+    memset(&profile, 0, sizeof(Profile));
+
+    profile.overhead = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t start = profile_ticks();
+        uint64_t ticks = profile_ticks() - start;
+        if (ticks < profile.overhead)
+            profile.overhead = ticks;
+    }
+}
+
+/************************ COUNTERS ************************/
+
+Counters counters;
+
+static const char *CPU_REGIONS[8] = {
+    "ram $0000", "ppu registers $2000", "apu/io $4000", "prg ram $6000",
+    "prg rom $8000", "prg rom $A000", "prg rom $C000", "prg rom $E000",
+};
+
+static const char *PPU_REGIONS[3] = {"pattern tables", "name tables", "palette"};
+
+/**
+ * @brief print the counters that aren't zero, the opcodes most run first
+ *
+ * @param file
+ * @param mapper_number mapper of the game being counted, bank switches depend on it
+ */
+void print_counters(FILE *file, uint8_t mapper_number) {
+    fprintf(file, "counters:\n");
+    for (int region = 0; region < 8; region++) {
+        if (counters.cpu_reads[region] || counters.cpu_writes[region])
+            fprintf(file, "  cpu %-20s reads %12llu  writes %12llu\n", CPU_REGIONS[region],
+                    (unsigned long long)counters.cpu_reads[region], (unsigned long long)counters.cpu_writes[region]);
+    }
+    for (int region = 0; region < 3; region++) {
+        if (counters.ppu_reads[region] || counters.ppu_writes[region])
+            fprintf(file, "  ppu %-20s reads %12llu  writes %12llu\n", PPU_REGIONS[region],
+                    (unsigned long long)counters.ppu_reads[region], (unsigned long long)counters.ppu_writes[region]);
+    }
+
+    fprintf(file, "  mapper %u: prg switches %llu (%llu bytes remapped), chr switches %llu (%llu bytes remapped), "
+            "chr tiles decoded %llu\n", mapper_number,
+            (unsigned long long)counters.prg_bank_switches, (unsigned long long)counters.prg_bytes_remapped,
+            (unsigned long long)counters.chr_bank_switches, (unsigned long long)counters.chr_bytes_remapped,
+            (unsigned long long)counters.chr_tiles_decoded);
+    fprintf(file, "  nmi %llu, irq %llu, oam dma %llu\n", (unsigned long long)counters.nmis,
+            (unsigned long long)counters.irqs, (unsigned long long)counters.oam_dmas);
+
+    // a simple selection sort, there are only 256 of them
+    uint64_t total = 0;
+    uint8_t order[256];
+    for (int i = 0; i < 256; i++) {
+        order[i] = i;
+        total += counters.opcodes[i];
+    }
+    for (int i = 0; i < 256; i++) {
+        int most = i;
+        for (int j = i + 1; j < 256; j++) {
+            if (counters.opcodes[order[j]] > counters.opcodes[order[most]])
+                most = j;
+        }
+        uint8_t swap = order[i];
+        order[i] = order[most];
+        order[most] = swap;
+    }
+
+    fprintf(file, "  instructions %llu\n", (unsigned long long)total);
+    for (int i = 0; i < 256 && counters.opcodes[order[i]]; i++) {
+        // operands of zero still show the addressing mode
+        uint8_t code[3] = {order[i], 0, 0};
+        char name[32];
+        Disassemble6502Op(code, name, sizeof(name));
+        fprintf(file, "    $%02x %-14s %12llu  %5.2f%%\n", order[i], name, (unsigned long long)counters.opcodes[order[i]],
+                100.0 * counters.opcodes[order[i]] / total);
+    }
+}
+
+/**
+ * @brief set every counter back to zero
+ */
+void reset_counters() {
+    memset(&counters, 0, sizeof(Counters));
+}
@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// time spent in the ppu and the mapper, measured only when built with -DNES_PROFILE. the cpu's share is what's
+// left of run_frame once they are taken out, frame output is timed by whoever draws the frame
+typedef enum ProfileSection {
+    PROFILE_PPU,
+    PROFILE_MAPPER,
+    PROFILE_SECTIONS
+} ProfileSection;
+
+typedef struct Profile {
+    uint64_t ticks[PROFILE_SECTIONS];
+    uint64_t overhead;  // ticks between two back to back timestamps, taken off short measurements
+} Profile;
+
+extern Profile profile;
+
+/**
+ * @brief a cheap timestamp, cpu cycles where there's a time stamp counter and nanoseconds elsewhere
+ *
+ * @return uint64_t
+ */
+static inline uint64_t profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+#ifdef NES_PROFILE
+#define PROFILE_START(name) uint64_t name = profile_ticks()
+#define PROFILE_STOP(section, name) profile.ticks[section] += profile_ticks() - name
+#else
+#define PROFILE_START(name)
+#define PROFILE_STOP(section, name)
+#endif
+
+/**
+ * @brief clear the times measured so far and measure the timer's own cost
+ */
+void reset_profile();
+
+// how often the hot paths run, counted only when built with -DNES_COUNTERS. banks are switched by pointing
+// windows at the rom rather than copying it, so a switch's cost shows as bytes remapped and chr tiles decoded again
+typedef struct Counters {
+    uint64_t cpu_reads[8];        // by 8K of cpu address space, $0000 ram up to $E000 rom
+    uint64_t cpu_writes[8];
+    uint64_t ppu_reads[3];        // pattern tables, name tables, palette
+    uint64_t ppu_writes[3];
+    uint64_t prg_bank_switches;   // calls to map_prg_bank, including ones that pick the banks already there
+    uint64_t prg_bytes_remapped;  // size of the windows that moved
+    uint64_t chr_bank_switches;
+    uint64_t chr_bytes_remapped;
+    uint64_t chr_tiles_decoded;
+    uint64_t nmis;
+    uint64_t irqs;
+    uint64_t oam_dmas;
+    uint64_t opcodes[256];        // instructions run, by opcode
+} Counters;
+
+extern Counters counters;
+
+#ifdef NES_COUNTERS
+#define COUNT(counter) (counters.counter++)
+#define COUNT_BY(counter, amount) (counters.counter += (amount))
+#else
+#define COUNT(counter) ((void)0)
+#define COUNT_BY(counter, amount) ((void)0)
+#endif
+
+// ppu address space regions as counted in ppu_reads and ppu_writes
+static inline int ppu_region(uint16_t address) {
+    return address <= 0x1fff ? 0 : address < 0x3f00 ? 1 : 2;
+}
+
+/**
+ * @brief print the counters that aren't zero, the opcodes most run first
+ *
+ * @param file
+ * @param mapper_number mapper of the game being counted, bank switches depend on it
+ */
+void print_counters(FILE *file, uint8_t mapper_number);
+
+/**
+ * @brief set every counter back to zero
+ */
+void reset_counters();
+
+#endif
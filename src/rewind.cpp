@@ -0,0 +1,388 @@
+#include "rewind.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "2C02.h"
+#include "6502.h"
+#include "bus.hpp"
+
+/**
+ * @brief creates an empty rewind buffer
+ *
+ * @param budget bytes of encoded frames to keep
+ * @param max_frames most frames to keep
+ * @param keyframe_interval frames between keyframes
+ * @return Rewind*
+ */
+Rewind *InitRewind(uint32_t budget, uint32_t max_frames, uint32_t keyframe_interval) {
+    Rewind *rewind = (Rewind *)malloc(sizeof(Rewind));
+
+    // a full frame list has to hold at least two keyframes, so dropping the oldest never drops them all
+    if (max_frames < 2)
+        max_frames = 2;
+    if (keyframe_interval > max_frames / 2)
+        keyframe_interval = max_frames / 2;
+    if (keyframe_interval < 1)
+        keyframe_interval = 1;
+
+    rewind->data = (uint8_t *)malloc(budget);
+    rewind->budget = budget;
+    rewind->head = 0;
+    rewind->used = 0;
+
+    rewind->frames = (RewindFrame *)malloc(sizeof(RewindFrame) * max_frames);
+    rewind->max_frames = max_frames;
+    rewind->first = 0;
+    rewind->count = 0;
+    rewind->keyframes = 0;
+    rewind->keyframe_interval = keyframe_interval;
+    rewind->since_keyframe = 0;
+
+    rewind->current = InitSaveState();
+    rewind->scratch = InitSaveState();
+    rewind->encoded_capacity = 0;
+    rewind->encoded = NULL;
+
+    return rewind;
+}
+
+/**
+ * @brief free a rewind buffer
+ *
+ * @param rewind
+ */
+void free_rewind(Rewind *rewind) {
+    free(rewind->data);
+    free(rewind->frames);
+    free_save_state(rewind->current);
+    free_save_state(rewind->scratch);
+    free(rewind->encoded);
+    free(rewind);
+}
+
+/************************ ENCODING ************************/
+
+// a frame is a list of (unchanged bytes, changed bytes, the changed bytes xored with the frame before) runs,
+// both counts as 7 bit varints. bytes after the last run are unchanged
+
+static void write_varint(uint8_t **out, uint32_t value) {
+    while (value >= 0x80) {
+        *(*out)++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *(*out)++ = value;
+}
+
+static uint32_t read_varint(const uint8_t **in) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *(*in)++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+}
+
+static inline uint8_t byte_delta(const uint8_t *previous, const uint8_t *state, uint32_t i) {
+    return previous ? previous[i] ^ state[i] : state[i];
+}
+
+/**
+ * @brief encode a state against the one before it
+ *
+ * @param previous NULL for a keyframe
+ * @param state
+ * @param size
+ * @param out room for 2 * size + 16 bytes
+ * @return uint32_t bytes written
+ */
+static uint32_t encode_frame(const uint8_t *previous, const uint8_t *state, uint32_t size, uint8_t *out) {
+    uint8_t *start = out;
+    uint32_t i = 0;
+
+    while (i < size) {
+        // skip unchanged bytes, 8 at a time while they last
+        uint32_t unchanged_start = i;
+        while (i + 8 <= size) {
+            uint64_t a = 0;
+            uint64_t b;
+            if (previous)
+                memcpy(&a, &previous[i], 8);
+            memcpy(&b, &state[i], 8);
+            if (a != b)
+                break;
+            i += 8;
+        }
+        while (i < size && byte_delta(previous, state, i) == 0)
+            i++;
+
+        if (i == size)
+            break;
+
+        // changed bytes run until 4 unchanged ones in a row, shorter gaps are cheaper to keep
+        uint32_t changed_start = i;
+        while (i < size) {
+            if (byte_delta(previous, state, i) != 0) {
+                i++;
+                continue;
+            }
+
+            uint32_t run = 1;
+            while (run < 4 && i + run < size && byte_delta(previous, state, i + run) == 0)
+                run++;
+            if (run == 4 || i + run == size)
+                break;
+            i += run;
+        }
+
+        write_varint(&out, changed_start - unchanged_start);
+        write_varint(&out, i - changed_start);
+        for (uint32_t j = changed_start; j < i; j++)
+            *out++ = byte_delta(previous, state, j);
+    }
+
+    return out - start;
+}
+
+/**
+ * @brief xor an encoded frame into a state, turning the frame before it into this one
+ *
+ * @param data
+ * @param size
+ * @param state
+ */
+static void apply_frame(const uint8_t *data, uint32_t size, uint8_t *state) {
+    const uint8_t *in = data;
+    const uint8_t *end = data + size;
+    uint32_t i = 0;
+
+    while (in < end) {
+        i += read_varint(&in);
+        uint32_t changed = read_varint(&in);
+        for (uint32_t j = 0; j < changed; j++)
+            state[i + j] ^= in[j];
+        in += changed;
+        i += changed;
+    }
+}
+
+static void resize_state(SaveState *state, uint32_t size) {
+    if (size > state->capacity) {
+        state->capacity = size;
+        state->data = (uint8_t *)realloc(state->data, state->capacity);
+    }
+    state->size = size;
+}
+
+/************************ FRAMES ************************/
+
+static inline RewindFrame *frame_at(Rewind *rewind, uint32_t index) {
+    return &rewind->frames[(rewind->first + index) % rewind->max_frames];
+}
+
+/**
+ * @brief decode a frame in full, from the keyframe at or before it
+ *
+ * @param rewind
+ * @param index frames after the oldest one
+ * @param state
+ */
+static void rebuild_frame(Rewind *rewind, uint32_t index, SaveState *state) {
+    uint32_t keyframe = index;
+    while (!frame_at(rewind, keyframe)->keyframe)
+        keyframe--;
+
+    resize_state(state, frame_at(rewind, keyframe)->state_size);
+    memset(state->data, 0, state->size);
+    for (uint32_t i = keyframe; i <= index; i++) {
+        RewindFrame *frame = frame_at(rewind, i);
+        apply_frame(&rewind->data[frame->offset], frame->size, state->data);
+    }
+}
+
+static void clear_frames(Rewind *rewind) {
+    rewind->first = 0;
+    rewind->count = 0;
+    rewind->keyframes = 0;
+    rewind->since_keyframe = 0;
+    rewind->head = 0;
+    rewind->used = 0;
+}
+
+/**
+ * @brief forget the oldest keyframe and the deltas that depend on it
+ *
+ * @param rewind
+ */
+static void drop_oldest_keyframe(Rewind *rewind) {
+    do {
+        RewindFrame *frame = frame_at(rewind, 0);
+        if (frame->keyframe)
+            rewind->keyframes--;
+        rewind->used -= frame->size;
+        rewind->first = (rewind->first + 1) % rewind->max_frames;
+        rewind->count--;
+    } while (rewind->count > 0 && !frame_at(rewind, 0)->keyframe);
+}
+
+/**
+ * @brief find room for a frame in the data ring, dropping old keyframes to make it
+ *
+ * @param rewind
+ * @param size
+ * @param offset set to where the frame goes
+ * @return bool false if the frame doesn't fit without dropping the newest keyframe
+ */
+static bool find_room(Rewind *rewind, uint32_t size, uint32_t *offset) {
+    while (true) {
+        if (rewind->count == 0) {
+            rewind->head = 0;
+            *offset = 0;
+            return size <= rewind->budget;
+        }
+
+        // the ring has wrapped when the newest frame sits before the oldest one
+        uint32_t oldest = frame_at(rewind, 0)->offset;
+        bool wrapped = frame_at(rewind, rewind->count - 1)->offset < oldest;
+
+        if (rewind->count < rewind->max_frames) {
+            if (wrapped && oldest - rewind->head >= size) {
+                *offset = rewind->head;
+                return true;
+            }
+            if (!wrapped && rewind->budget - rewind->head >= size) {
+                *offset = rewind->head;
+                return true;
+            }
+            if (!wrapped && oldest >= size) {
+                *offset = 0;
+                return true;
+            }
+        }
+
+        if (rewind->keyframes < 2)
+            return false;
+        drop_oldest_keyframe(rewind);
+    }
+}
+
+/**
+ * @brief record the machine as the newest frame, call once after each run_frame
+ *
+ * @param rewind
+ * @param bus
+ */
+void record_rewind_frame(Rewind *rewind, Bus *bus) {
+    save_state(bus, rewind->scratch);
+
+    uint32_t size = rewind->scratch->size;
+    if (rewind->encoded_capacity < 2 * size + 16) {
+        rewind->encoded_capacity = 2 * size + 16;
+        rewind->encoded = (uint8_t *)realloc(rewind->encoded, rewind->encoded_capacity);
+    }
+
+    bool keyframe = rewind->count == 0 || rewind->since_keyframe + 1 >= rewind->keyframe_interval ||
+                    rewind->current->size != size;
+    uint32_t encoded_size = encode_frame(keyframe ? NULL : rewind->current->data, rewind->scratch->data, size,
+                                         rewind->encoded);
+
+    uint32_t offset;
+    if (!find_room(rewind, encoded_size, &offset)) {
+        // only the newest keyframe is left and it's in the way, start over from this frame
+        clear_frames(rewind);
+        if (!keyframe) {
+            keyframe = true;
+            encoded_size = encode_frame(NULL, rewind->scratch->data, size, rewind->encoded);
+        }
+        if (!find_room(rewind, encoded_size, &offset))
+            return;
+    }
+
+    RewindFrame *frame = frame_at(rewind, rewind->count);
+    frame->offset = offset;
+    frame->size = encoded_size;
+    frame->state_size = size;
+    frame->keyframe = keyframe;
+    memcpy(&rewind->data[offset], rewind->encoded, encoded_size);
+
+    rewind->head = offset + encoded_size;
+    rewind->used += encoded_size;
+    rewind->count++;
+    if (keyframe) {
+        rewind->keyframes++;
+        rewind->since_keyframe = 0;
+    }
+    else {
+        rewind->since_keyframe++;
+    }
+
+    // the recorded state is what the next frame's delta is taken against
+    SaveState *current = rewind->current;
+    rewind->current = rewind->scratch;
+    rewind->scratch = current;
+}
+
+/**
+ * @brief step the machine back to the frame before the newest one and forget the newest
+ *
+ * @param rewind
+ * @param bus
+ * @return bool false if there was no earlier frame to go back to
+ */
+bool rewind_frame(Rewind *rewind, Bus *bus) {
+    if (rewind->count < 2)
+        return false;
+
+    RewindFrame newest = *frame_at(rewind, rewind->count - 1);
+    rewind->count--;
+    rewind->used -= newest.size;
+
+    RewindFrame *previous = frame_at(rewind, rewind->count - 1);
+    rewind->head = previous->offset + previous->size;
+
+    // undoing a delta is xoring it in again, a keyframe has to be rebuilt from the keyframe before it
+    if (newest.keyframe) {
+        rewind->keyframes--;
+        rebuild_frame(rewind, rewind->count - 1, rewind->current);
+
+        rewind->since_keyframe = 0;
+        while (!frame_at(rewind, rewind->count - 1 - rewind->since_keyframe)->keyframe)
+            rewind->since_keyframe++;
+    }
+    else {
+        apply_frame(&rewind->data[newest.offset], newest.size, rewind->current->data);
+        rewind->since_keyframe--;
+    }
+
+    // the frame buffer isn't part of a state, so run the frame again from the one before it to show it
+    if (rewind->count >= 2) {
+        if (previous->keyframe) {
+            rebuild_frame(rewind, rewind->count - 2, rewind->scratch);
+        }
+        else {
+            resize_state(rewind->scratch, rewind->current->size);
+            memcpy(rewind->scratch->data, rewind->current->data, rewind->current->size);
+            apply_frame(&rewind->data[previous->offset], previous->size, rewind->scratch->data);
+        }
+
+        // the frame was traced when it first ran, so keep the redraw out of the trace
+        bool debug = bus->cpu->debug;
+        bus->cpu->debug = false;
+        if (load_state(bus, rewind->scratch))
+            run_frame(bus);
+        bus->cpu->debug = debug;
+    }
+
+    return load_state(bus, rewind->current);
+}
+
+/**
+ * @brief bytes of the data ring in use
+ *
+ * @param rewind
+ * @return uint32_t
+ */
+uint32_t rewind_bytes_used(Rewind *rewind) {
+    return rewind->used;
+}
@@ -0,0 +1,82 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "savestate.h"
+
+#ifndef REWIND_H
+#define REWIND_H
+
+// each recorded frame is a save state stored as the xor with the frame before it, with runs of unchanged
+// bytes left out. every keyframe_interval frames (and whenever the previous frame is gone) a keyframe stores
+// the whole state the same way, against zeros. the oldest keyframe and its deltas are dropped when the
+// buffer or frame list is full
+typedef struct RewindFrame {
+    uint32_t offset;      // where the frame starts in the data ring
+    uint32_t size;        // encoded bytes
+    uint32_t state_size;  // bytes of the decoded state
+    bool keyframe;
+} RewindFrame;
+
+typedef struct Rewind {
+    uint8_t *data;          // ring of encoded frames
+    uint32_t budget;        // bytes in data
+    uint32_t head;          // end of the newest frame in data
+    uint32_t used;          // bytes of encoded frames held
+
+    RewindFrame *frames;    // ring of frames, oldest at first
+    uint32_t max_frames;
+    uint32_t first;
+    uint32_t count;
+    uint32_t keyframes;     // keyframes among the frames held
+    uint32_t keyframe_interval;
+    uint32_t since_keyframe;
+
+    SaveState *current;     // the newest frame in full, what the next delta is taken against
+    SaveState *scratch;     // the state being recorded or rebuilt
+    uint8_t *encoded;       // a frame being encoded, before it is placed in the ring
+    uint32_t encoded_capacity;
+} Rewind;
+
+/**
+ * @brief creates an empty rewind buffer
+ *
+ * @param budget bytes of encoded frames to keep
+ * @param max_frames most frames to keep
+ * @param keyframe_interval frames between keyframes
+ * @return Rewind*
+ */
+Rewind *InitRewind(uint32_t budget, uint32_t max_frames, uint32_t keyframe_interval);
+
+/**
+ * @brief free a rewind buffer
+ *
+ * @param rewind
+ */
+void free_rewind(Rewind *rewind);
+
+/**
+ * @brief record the machine as the newest frame, call once after each run_frame
+ *
+ * @param rewind
+ * @param bus
+ */
+void record_rewind_frame(Rewind *rewind, struct Bus *bus);
+
+/**
+ * @brief step the machine back to the frame before the newest one and forget the newest
+ *
+ * @param rewind
+ * @param bus
+ * @return bool false if there was no earlier frame to go back to
+ */
+bool rewind_frame(Rewind *rewind, struct Bus *bus);
+
+/**
+ * @brief bytes of the data ring in use
+ *
+ * @param rewind
+ * @return uint32_t
+ */
+uint32_t rewind_bytes_used(Rewind *rewind);
+
+#endif
@@ -0,0 +1,474 @@
+#include "savestate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "2C02.h"
+#include "6502.h"
+#include "bus.hpp"
+#include "controller.h"
+#include "mapper.hpp"
+
+/**
+ * @brief creates an empty save state buffer
+ *
+ * @return SaveState*
+ */
+SaveState *InitSaveState() {
+    SaveState *state = (SaveState *)malloc(sizeof(SaveState));
+
+    state->capacity = 0x10000;
+    state->data = (uint8_t *)malloc(state->capacity);
+    state->size = 0;
+    state->position = 0;
+    state->error = false;
+
+    return state;
+}
+
+/**
+ * @brief free a save state buffer
+ *
+ * @param state
+ */
+void free_save_state(SaveState *state) {
+    free(state->data);
+    free(state);
+}
+
+/**
+ * @brief append bytes to a state
+ *
+ * @param state
+ * @param data
+ * @param size
+ */
+void save_bytes(SaveState *state, const void *data, uint32_t size) {
+    if (state->size + size > state->capacity) {
+        while (state->size + size > state->capacity)
+            state->capacity *= 2;
+        state->data = (uint8_t *)realloc(state->data, state->capacity);
+    }
+
+    memcpy(&state->data[state->size], data, size);
+    state->size += size;
+}
+
+/**
+ * @brief read bytes from a state, zeros (and error set) past its end
+ *
+ * @param state
+ * @param data
+ * @param size
+ */
+void load_bytes(SaveState *state, void *data, uint32_t size) {
+    if (state->position + size > state->size) {
+        memset(data, 0, size);
+        state->position = state->size;
+        state->error = true;
+        return;
+    }
+
+    memcpy(data, &state->data[state->position], size);
+    state->position += size;
+}
+
+/************************ CPU ************************/
+
+static void save_cpu(State6502 *cpu, SaveState *state) {
+    save_u8(state, cpu->a);
+    save_u8(state, cpu->x);
+    save_u8(state, cpu->y);
+
+    save_u16(state, cpu->sr.nz);
+    save_u8(state, cpu->sr.v);
+    save_u8(state, cpu->sr.b);
+    save_u8(state, cpu->sr.d);
+    save_u8(state, cpu->sr.i);
+    save_u8(state, cpu->sr.c);
+
+    save_u8(state, cpu->sp);
+    save_u16(state, cpu->pc);
+    save_u8(state, cpu->int_enable);
+    save_u8(state, cpu->halted);
+    save_u16(state, cpu->cycles);
+    save_u64(state, cpu->instructions);
+}
+
+static void load_cpu(State6502 *cpu, SaveState *state) {
+    cpu->a = load_u8(state);
+    cpu->x = load_u8(state);
+    cpu->y = load_u8(state);
+
+    cpu->sr.nz = load_u16(state);
+    cpu->sr.v = load_u8(state);
+    cpu->sr.b = load_u8(state);
+    cpu->sr.d = load_u8(state);
+    cpu->sr.i = load_u8(state);
+    cpu->sr.c = load_u8(state);
+
+    cpu->sp = load_u8(state);
+    cpu->pc = load_u16(state);
+    cpu->int_enable = load_u8(state);
+    cpu->halted = load_u8(state);
+    cpu->cycles = load_u16(state);
+    cpu->instructions = load_u64(state);
+
+    // the loop being timed is from before the load
+    if (cpu->idle_loop) {
+        cpu->idle_loop->pc = 0;
+        cpu->idle_loop->instructions = 0;
+    }
+}
+
+/************************ PPU ************************/
+
+// the frame buffer is only output, and is drawn again in full by the next frame
+static void save_ppu(State2C02 *ppu, SaveState *state) {
+    save_u8(state, ppu->control.reg);
+    save_u8(state, ppu->mask.reg);
+    save_u8(state, ppu->status.reg);
+    save_u8(state, ppu->oamaddr.address);
+    save_u8(state, ppu->oamdata.data);
+    save_u8(state, ppu->ppuscroll.scroll);
+    save_u8(state, ppu->ppuaddr.address_byte);
+    save_u8(state, ppu->ppudata.data);
+    save_u8(state, ppu->oamdma.address_high_byte);
+    save_u8(state, ppu->mirror_mode);
+
+    save_u16(state, ppu->vram_address.reg);
+    save_u16(state, ppu->tram_address.reg);
+    save_u8(state, ppu->fine_x);
+    save_u8(state, ppu->w);
+
+    save_bytes(state, ppu->primary_oam, sizeof(Sprite) * 0x40);
+    save_bytes(state, ppu->secondary_oam, sizeof(Sprite) * 0x08);
+    save_u8(state, ppu->n);
+    save_u8(state, ppu->sprite_count);
+    save_bytes(state, ppu->sprite_shifter_pattern_lo, 0x8);
+    save_bytes(state, ppu->sprite_shifter_pattern_hi, 0x8);
+    for (int i = 0; i < 8; i++)
+        save_u64(state, ppu->sprite_rows[i]);
+    save_u16(state, ppu->sprite_row_address);
+    save_u8(state, ppu->sprite_found);
+    save_u8(state, ppu->sprite_zero_on_scanline);
+    save_u8(state, ppu->sprite_zero_rendered);
+
+    save_u8(state, ppu->data_buffer);
+    save_u8(state, ppu->io_db);
+
+    save_u8(state, ppu->bg_next_tile_index);
+    save_u8(state, ppu->bg_next_tile_attribute);
+    save_u8(state, ppu->bg_next_tile_lsb);
+    save_u8(state, ppu->bg_next_tile_msb);
+    save_u16(state, ppu->bg_shifter_pattern_lo);
+    save_u16(state, ppu->bg_shifter_pattern_hi);
+    save_u16(state, ppu->bg_shifter_attribute_lo);
+    save_u16(state, ppu->bg_shifter_attribute_hi);
+
+    save_u16(state, ppu->scanline);
+    save_u16(state, ppu->cycles);
+    save_u8(state, ppu->nmi);
+    save_u8(state, ppu->frame_complete);
+    save_u32(state, ppu->frame_count);
+}
+
+static void load_ppu(State2C02 *ppu, SaveState *state) {
+    // kept to see whether the sprite index still fits
+    Sprite oam[0x40];
+    memcpy(oam, ppu->primary_oam, sizeof(Sprite) * 0x40);
+    uint8_t sprite_height = ppu->control.sprite_height;
+
+    ppu->control.reg = load_u8(state);
+    ppu->mask.reg = load_u8(state);
+    ppu->status.reg = load_u8(state);
+    ppu->oamaddr.address = load_u8(state);
+    ppu->oamdata.data = load_u8(state);
+    ppu->ppuscroll.scroll = load_u8(state);
+    ppu->ppuaddr.address_byte = load_u8(state);
+    ppu->ppudata.data = load_u8(state);
+    ppu->oamdma.address_high_byte = load_u8(state);
+    ppu->mirror_mode = load_u8(state);
+
+    ppu->vram_address.reg = load_u16(state);
+    ppu->tram_address.reg = load_u16(state);
+    ppu->fine_x = load_u8(state);
+    ppu->w = load_u8(state);
+
+    load_bytes(state, ppu->primary_oam, sizeof(Sprite) * 0x40);
+    load_bytes(state, ppu->secondary_oam, sizeof(Sprite) * 0x08);
+    ppu->n = load_u8(state);
+    ppu->sprite_count = load_u8(state);
+    load_bytes(state, ppu->sprite_shifter_pattern_lo, 0x8);
+    load_bytes(state, ppu->sprite_shifter_pattern_hi, 0x8);
+    for (int i = 0; i < 8; i++)
+        ppu->sprite_rows[i] = load_u64(state);
+    ppu->sprite_row_address = load_u16(state);
+    ppu->sprite_found = load_u8(state);
+    ppu->sprite_zero_on_scanline = load_u8(state);
+    ppu->sprite_zero_rendered = load_u8(state);
+
+    ppu->data_buffer = load_u8(state);
+    ppu->io_db = load_u8(state);
+
+    ppu->bg_next_tile_index = load_u8(state);
+    ppu->bg_next_tile_attribute = load_u8(state);
+    ppu->bg_next_tile_lsb = load_u8(state);
+    ppu->bg_next_tile_msb = load_u8(state);
+    ppu->bg_shifter_pattern_lo = load_u16(state);
+    ppu->bg_shifter_pattern_hi = load_u16(state);
+    ppu->bg_shifter_attribute_lo = load_u16(state);
+    ppu->bg_shifter_attribute_hi = load_u16(state);
+
+    ppu->scanline = (int16_t)load_u16(state);
+    ppu->cycles = (int16_t)load_u16(state);
+    ppu->nmi = load_u8(state);
+    ppu->frame_complete = load_u8(state);
+    ppu->frame_count = load_u32(state);
+
+    // the sprite index is rebuilt from the restored oam, if it differs
+    if (memcmp(oam, ppu->primary_oam, sizeof(Sprite) * 0x40) != 0 || ppu->control.sprite_height != sprite_height)
+        ppu->sprite_index_dirty = true;
+}
+
+/************************ BUS ************************/
+
+static void save_bus(Bus *bus, SaveState *state) {
+    save_bytes(state, bus->cpu_ram, 0x800);
+    save_bytes(state, bus->ppu_registers, 0x8);
+    save_bytes(state, bus->apu_io_registers, 0x18);
+    save_bytes(state, bus->unmapped, 0x3FE0);
+
+    if (bus->chr_writable)
+        save_bytes(state, bus->chr_ram, 0x2000);
+    save_bytes(state, bus->name_table_0, 0x400);
+    save_bytes(state, bus->name_table_1, 0x400);
+    save_bytes(state, bus->name_table_2, 0x400);
+    save_bytes(state, bus->name_table_3, 0x400);
+    save_bytes(state, bus->palette, 0x20);
+
+    // which of the four nametables each 1K slot shows
+    uint8_t *name_tables[4] = {bus->name_table_0, bus->name_table_1, bus->name_table_2, bus->name_table_3};
+    for (int slot = 0; slot < 4; slot++) {
+        uint8_t table = 0;
+        while (table < 3 && bus->name_tables[slot] != name_tables[table])
+            table++;
+        save_u8(state, table);
+    }
+
+    save_u64(state, bus->system_cycles);
+    save_u64(state, bus->cpu_clock);
+    save_u64(state, bus->ppu_deadline);
+    save_u8(state, bus->irq_pending);
+    save_u8(state, bus->a12_state_previous);
+    save_u8(state, bus->a12_state_current);
+    save_u32(state, bus->poll_input1);
+    save_u32(state, bus->poll_input2);
+
+    // buttons held on both ports, nothing held on a port with no controller
+    save_u8(state, bus->controller_1 ? get_controller_buttons(bus->controller_1) : 0);
+    save_u8(state, bus->controller_2 ? get_controller_buttons(bus->controller_2) : 0);
+}
+
+static void load_bus(Bus *bus, SaveState *state) {
+    load_bytes(state, bus->cpu_ram, 0x800);
+    load_bytes(state, bus->ppu_registers, 0x8);
+    load_bytes(state, bus->apu_io_registers, 0x18);
+    load_bytes(state, bus->unmapped, 0x3FE0);
+
+    // decoded tiles stay valid where chr ram didn't change, windows that move are dropped by map_chr_window
+    if (bus->chr_writable) {
+        uint8_t chr_ram[0x2000];
+        memcpy(chr_ram, bus->chr_ram, 0x2000);
+        load_bytes(state, bus->chr_ram, 0x2000);
+
+        for (int slot = 0; slot < 8; slot++) {
+            uint32_t offset = bus->chr_windows[slot] - bus->chr_ram;
+            for (int tile = 0; tile < 64; tile++) {
+                if (memcmp(&chr_ram[offset + tile * 16], &bus->chr_ram[offset + tile * 16], 16) != 0)
+                    bus->chr_tile_valid[slot * 64 + tile] = false;
+            }
+        }
+    }
+    load_bytes(state, bus->name_table_0, 0x400);
+    load_bytes(state, bus->name_table_1, 0x400);
+    load_bytes(state, bus->name_table_2, 0x400);
+    load_bytes(state, bus->name_table_3, 0x400);
+    load_bytes(state, bus->palette, 0x20);
+
+    uint8_t *name_tables[4] = {bus->name_table_0, bus->name_table_1, bus->name_table_2, bus->name_table_3};
+    for (int slot = 0; slot < 4; slot++)
+        bus->name_tables[slot] = name_tables[load_u8(state) & 0x3];
+
+    bus->system_cycles = load_u64(state);
+    bus->cpu_clock = load_u64(state);
+    bus->ppu_deadline = load_u64(state);
+    bus->irq_pending = load_u8(state);
+    bus->a12_state_previous = load_u8(state);
+    bus->a12_state_current = load_u8(state);
+    bus->poll_input1 = (int32_t)load_u32(state);
+    bus->poll_input2 = (int32_t)load_u32(state);
+
+    uint8_t buttons_1 = load_u8(state);
+    uint8_t buttons_2 = load_u8(state);
+    if (bus->controller_1)
+        set_controller_buttons(bus->controller_1, buttons_1);
+    if (bus->controller_2)
+        set_controller_buttons(bus->controller_2, buttons_2);
+}
+
+/************************ STATE ************************/
+
+/**
+ * @brief snapshot the whole machine into a state, replacing what it held
+ *
+ * @param bus
+ * @param state
+ */
+void save_state(Bus *bus, SaveState *state) {
+    Mapper *mapper = bus->mapper;
+
+    state->size = 0;
+    save_bytes(state, SAVESTATE_MAGIC, 8);
+    save_u32(state, SAVESTATE_VERSION);
+    save_u32(state, 0);  // size, filled in at the end
+    save_u8(state, mapper->mapper_number);
+    save_u32(state, mapper->prg_rom_size);
+    save_u32(state, mapper->chr_memory_size);
+
+    save_cpu(bus->cpu, state);
+    save_ppu(bus->ppu, state);
+    save_bus(bus, state);
+    mapper->serialize(state);
+
+    for (int i = 0; i < 4; i++)
+        state->data[12 + i] = state->size >> (8 * i);
+}
+
+/**
+ * @brief restore the machine from a state
+ *
+ * @param bus
+ * @param state
+ * @return bool false, with the machine untouched, if the state is from another version or rom, or cut short
+ */
+bool load_state(Bus *bus, SaveState *state) {
+    Mapper *mapper = bus->mapper;
+
+    // everything that could make the load fail is checked before the machine is touched
+    state->position = 0;
+    state->error = false;
+
+    char magic[8];
+    load_bytes(state, magic, 8);
+    uint32_t version = load_u32(state);
+    uint32_t size = load_u32(state);
+    uint8_t mapper_number = load_u8(state);
+    uint32_t prg_rom_size = load_u32(state);
+    uint32_t chr_memory_size = load_u32(state);
+
+    if (state->error || memcmp(magic, SAVESTATE_MAGIC, 8) != 0 || version != SAVESTATE_VERSION ||
+        size != state->size || mapper_number != mapper->mapper_number || prg_rom_size != mapper->prg_rom_size ||
+        chr_memory_size != mapper->chr_memory_size)
+        return false;
+
+    load_cpu(bus->cpu, state);
+    load_ppu(bus->ppu, state);
+    load_bus(bus, state);
+    mapper->deserialize(state);
+
+    return !state->error;
+}
+
+/************************ RUN AHEAD ************************/
+
+/**
+ * @brief run a frame, then show the frame the given number of frames after it and go back, so the picture
+ * reacts to input that much sooner. the frames in between are run without drawing them
+ *
+ * @param bus
+ * @param state holds the machine while it runs ahead
+ * @param frames 0 for a plain run_frame
+ * @return bool false if the machine couldn't be put back, and is left the given number of frames ahead
+ */
+bool run_frame_ahead(Bus *bus, SaveState *state, uint32_t frames) {
+    State2C02 *ppu = bus->ppu;
+    State6502 *cpu = bus->cpu;
+
+    if (frames == 0) {
+        run_frame(bus);
+        return true;
+    }
+
+    ppu->skip_pixels = true;
+    run_frame(bus);
+    save_state(bus, state);
+
+    // the frames ahead are run again for real later, keep them out of the trace and out of the idle loop
+    // being timed, which load_state would otherwise forget
+    bool debug = cpu->debug;
+    cpu->debug = false;
+    IdleLoop idle_loop = {};
+    if (cpu->idle_loop)
+        idle_loop = *cpu->idle_loop;
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        ppu->skip_pixels = frame + 1 < frames;
+        run_frame(bus);
+    }
+
+    cpu->debug = debug;
+    if (!load_state(bus, state))
+        return false;
+
+    if (cpu->idle_loop)
+        *cpu->idle_loop = idle_loop;
+    return true;
+}
+
+/**
+ * @brief write a state to a file
+ *
+ * @param state
+ * @param path
+ * @return bool
+ */
+bool write_state_file(SaveState *state, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    bool written = fwrite(state->data, 1, state->size, file) == state->size;
+    fclose(file);
+
+    return written;
+}
+
+/**
+ * @brief read a state from a file
+ *
+ * @param state
+ * @param path
+ * @return bool
+ */
+bool read_state_file(SaveState *state, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    state->size = 0;
+    if (size > state->capacity) {
+        state->capacity = size;
+        state->data = (uint8_t *)realloc(state->data, state->capacity);
+    }
+
+    bool read = size >= 0 && fread(state->data, 1, size, file) == (size_t)size;
+    fclose(file);
+
+    state->size = read ? size : 0;
+    return read;
+}
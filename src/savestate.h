@@ -0,0 +1,157 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+// a save state starts with a header: the magic, the version and the size of the whole state, then the
+// mapper number and rom sizes it was taken with. the cpu, ppu, bus memory and mapper follow, see save_state
+#define SAVESTATE_MAGIC "NESSTATE"
+#define SAVESTATE_VERSION 2
+
+typedef struct SaveState {
+    uint8_t *data;
+    uint32_t size;      // bytes of state in data
+    uint32_t capacity;  // bytes allocated, grows as needed and is kept between saves
+    uint32_t position;  // read position while loading
+    bool error;         // a load ran past the end of the state
+} SaveState;
+
+struct Bus;
+
+/**
+ * @brief creates an empty save state buffer
+ *
+ * @return SaveState*
+ */
+SaveState *InitSaveState();
+
+/**
+ * @brief free a save state buffer
+ *
+ * @param state
+ */
+void free_save_state(SaveState *state);
+
+/**
+ * @brief append bytes to a state
+ *
+ * @param state
+ * @param data
+ * @param size
+ */
+void save_bytes(SaveState *state, const void *data, uint32_t size);
+
+/**
+ * @brief read bytes from a state, zeros (and error set) past its end
+ *
+ * @param state
+ * @param data
+ * @param size
+ */
+void load_bytes(SaveState *state, void *data, uint32_t size);
+
+// numbers are stored little endian
+static inline void save_u8(SaveState *state, uint8_t value) {
+    save_bytes(state, &value, 1);
+}
+
+static inline void save_u16(SaveState *state, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    save_bytes(state, bytes, 2);
+}
+
+static inline void save_u32(SaveState *state, uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; i++)
+        bytes[i] = value >> (8 * i);
+    save_bytes(state, bytes, 4);
+}
+
+static inline void save_u64(SaveState *state, uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++)
+        bytes[i] = value >> (8 * i);
+    save_bytes(state, bytes, 8);
+}
+
+static inline uint8_t load_u8(SaveState *state) {
+    uint8_t value;
+    load_bytes(state, &value, 1);
+    return value;
+}
+
+static inline uint16_t load_u16(SaveState *state) {
+    uint8_t bytes[2];
+    load_bytes(state, bytes, 2);
+    return bytes[0] | (bytes[1] << 8);
+}
+
+static inline uint32_t load_u32(SaveState *state) {
+    uint8_t bytes[4];
+    load_bytes(state, bytes, 4);
+
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)bytes[i] << (8 * i);
+    return value;
+}
+
+static inline uint64_t load_u64(SaveState *state) {
+    uint8_t bytes[8];
+    load_bytes(state, bytes, 8);
+
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= (uint64_t)bytes[i] << (8 * i);
+    return value;
+}
+
+/**
+ * @brief snapshot the whole machine into a state, replacing what it held
+ *
+ * @param bus
+ * @param state
+ */
+void save_state(struct Bus *bus, SaveState *state);
+
+/**
+ * @brief restore the machine from a state
+ *
+ * @param bus
+ * @param state
+ * @return bool false, with the machine untouched, if the state is from another version or rom, or cut short
+ */
+bool load_state(struct Bus *bus, SaveState *state);
+
+/**
+ * @brief run a frame, then show the frame the given number of frames after it and go back, so the picture
+ * reacts to input that much sooner. the frames in between are run without drawing them
+ *
+ * @param bus
+ * @param state holds the machine while it runs ahead
+ * @param frames 0 for a plain run_frame
+ * @return bool false if the machine couldn't be put back, and is left the given number of frames ahead
+ */
+bool run_frame_ahead(struct Bus *bus, SaveState *state, uint32_t frames);
+
+/**
+ * @brief write a state to a file
+ *
+ * @param state
+ * @param path
+ * @return bool
+ */
+bool write_state_file(SaveState *state, const char *path);
+
+/**
+ * @brief read a state from a file
+ *
+ * @param state
+ * @param path
+ * @return bool
+ */
+bool read_state_file(SaveState *state, const char *path);
+
+#endif
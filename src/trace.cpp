@@ -0,0 +1,560 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief creates a trace that writes every line to a file through a large buffer
+ *
+ * @param file
+ * @return Trace*
+ */
+Trace *InitFileTrace(FILE *file) {
+    Trace *trace = (Trace *)malloc(sizeof(Trace));
+
+    trace->file = file;
+    trace->binary = false;
+    trace->buffer = (char *)malloc(TRACE_BUFFER_SIZE);
+    trace->buffered = 0;
+
+    trace->ring = NULL;
+    trace->ring_lines = 0;
+    trace->lines = 0;
+
+    return trace;
+}
+
+/**
+ * @brief creates a trace that writes a binary record for every instruction to a file, through a large buffer
+ *
+ * @param file
+ * @return Trace*
+ */
+Trace *InitBinaryTrace(FILE *file) {
+    Trace *trace = InitFileTrace(file);
+    trace->binary = true;
+
+    uint8_t header[16];
+    memcpy(header, TRACE_MAGIC, 8);
+    for (int i = 0; i < 4; i++) {
+        header[8 + i] = (TRACE_VERSION >> (8 * i)) & 0xff;
+        header[12 + i] = (TRACE_RECORD_SIZE >> (8 * i)) & 0xff;
+    }
+
+    memcpy(trace->buffer, header, sizeof(header));
+    trace->buffered = sizeof(header);
+
+    return trace;
+}
+
+/**
+ * @brief creates a trace that only keeps the last lines in memory
+ *
+ * @param lines
+ * @return Trace*
+ */
+Trace *InitRingTrace(uint32_t lines) {
+    Trace *trace = (Trace *)malloc(sizeof(Trace));
+
+    trace->file = NULL;
+    trace->binary = false;
+    trace->buffer = NULL;
+    trace->buffered = 0;
+
+    trace->ring = (char *)calloc(lines, TRACE_LINE_LENGTH);
+    trace->ring_lines = lines;
+    trace->lines = 0;
+
+    return trace;
+}
+
+/**
+ * @brief add a line to the trace, without allocating
+ *
+ * @param trace
+ * @param line ends with a newline
+ * @param length
+ */
+void write_trace_line(Trace *trace, const char *line, uint32_t length) {
+    if (length > TRACE_LINE_LENGTH - 1)
+        length = TRACE_LINE_LENGTH - 1;
+
+    if (trace->file) {
+        if (trace->buffered + length > TRACE_BUFFER_SIZE)
+            flush_trace(trace);
+
+        memcpy(&trace->buffer[trace->buffered], line, length);
+        trace->buffered += length;
+    }
+
+    else {
+        char *slot = &trace->ring[(trace->lines % trace->ring_lines) * TRACE_LINE_LENGTH];
+        memcpy(slot, line, length);
+        slot[length] = '\0';
+    }
+
+    trace->lines++;
+}
+
+/**
+ * @brief add a binary record to the trace, without allocating
+ *
+ * @param trace
+ * @param record TRACE_RECORD_SIZE bytes
+ */
+void write_trace_record(Trace *trace, const uint8_t *record) {
+    if (trace->buffered + TRACE_RECORD_SIZE > TRACE_BUFFER_SIZE)
+        flush_trace(trace);
+
+    memcpy(&trace->buffer[trace->buffered], record, TRACE_RECORD_SIZE);
+    trace->buffered += TRACE_RECORD_SIZE;
+    trace->lines++;
+}
+
+/**
+ * @brief write the lines kept by a ring trace to a file, oldest first
+ *
+ * @param trace
+ * @param file
+ */
+void dump_trace(Trace *trace, FILE *file) {
+    if (!trace->ring)
+        return;
+
+    uint64_t first = trace->lines > trace->ring_lines ? trace->lines - trace->ring_lines : 0;
+    for (uint64_t line = first; line < trace->lines; line++)
+        fputs(&trace->ring[(line % trace->ring_lines) * TRACE_LINE_LENGTH], file);
+}
+
+/**
+ * @brief write out the buffered lines of a file trace
+ *
+ * @param trace
+ */
+void flush_trace(Trace *trace) {
+    if (!trace->file)
+        return;
+
+    fwrite(trace->buffer, 1, trace->buffered, trace->file);
+    fflush(trace->file);
+    trace->buffered = 0;
+}
+
+/**
+ * @brief flush the trace and free it, the file is left open
+ *
+ * @param trace
+ */
+void close_trace(Trace *trace) {
+    flush_trace(trace);
+
+    free(trace->buffer);
+    free(trace->ring);
+    free(trace);
+}
+
+/************************ FORMATS ************************/
+
+// addressing modes as nestest writes them
+enum TraceMode {
+    IMP,  // CLC
+    ACC,  // LSR A
+    IMM,  // LDA #$00
+    ZP,   // LDA $00 = 00
+    ZPX,  // LDA $00,X @ 00 = 00
+    ZPY,  // LDX $00,Y @ 00 = 00
+    ABS,  // LDA $0000 = 00
+    ABX,  // LDA $0000,X @ 0000 = 00
+    ABY,  // LDA $0000,Y @ 0000 = 00
+    IND,  // JMP ($0000) = 0000
+    IZX,  // LDA ($00,X) @ 00 = 0000 = 00
+    IZY,  // LDA ($00),Y = 0000 @ 0000 = 00
+    REL,  // BNE $0000
+};
+
+// unofficial opcodes start with a *, which nestest puts in the column before the mnemonic
+static const char *const TRACE_MNEMONICS[256] = {
+    "BRK", "ORA", "*KIL", "*SLO", "*NOP", "ORA", "ASL", "*SLO", "PHP", "ORA", "ASL", "*ANC", "*NOP", "ORA", "ASL", "*SLO",
+    "BPL", "ORA", "*KIL", "*SLO", "*NOP", "ORA", "ASL", "*SLO", "CLC", "ORA", "*NOP", "*SLO", "*NOP", "ORA", "ASL", "*SLO",
+    "JSR", "AND", "*KIL", "*RLA", "BIT", "AND", "ROL", "*RLA", "PLP", "AND", "ROL", "*ANC", "BIT", "AND", "ROL", "*RLA",
+    "BMI", "AND", "*KIL", "*RLA", "*NOP", "AND", "ROL", "*RLA", "SEC", "AND", "*NOP", "*RLA", "*NOP", "AND", "ROL", "*RLA",
+    "RTI", "EOR", "*KIL", "*SRE", "*NOP", "EOR", "LSR", "*SRE", "PHA", "EOR", "LSR", "*ALR", "JMP", "EOR", "LSR", "*SRE",
+    "BVC", "EOR", "*KIL", "*SRE", "*NOP", "EOR", "LSR", "*SRE", "CLI", "EOR", "*NOP", "*SRE", "*NOP", "EOR", "LSR", "*SRE",
+    "RTS", "ADC", "*KIL", "*RRA", "*NOP", "ADC", "ROR", "*RRA", "PLA", "ADC", "ROR", "*ARR", "JMP", "ADC", "ROR", "*RRA",
+    "BVS", "ADC", "*KIL", "*RRA", "*NOP", "ADC", "ROR", "*RRA", "SEI", "ADC", "*NOP", "*RRA", "*NOP", "ADC", "ROR", "*RRA",
+    "*NOP", "STA", "*NOP", "*SAX", "STY", "STA", "STX", "*SAX", "DEY", "*NOP", "TXA", "*XAA", "STY", "STA", "STX", "*SAX",
+    "BCC", "STA", "*KIL", "*AHX", "STY", "STA", "STX", "*SAX", "TYA", "STA", "TXS", "*TAS", "*SHY", "STA", "*SHX", "*AHX",
+    "LDY", "LDA", "LDX", "*LAX", "LDY", "LDA", "LDX", "*LAX", "TAY", "LDA", "TAX", "*LAX", "LDY", "LDA", "LDX", "*LAX",
+    "BCS", "LDA", "*KIL", "*LAX", "LDY", "LDA", "LDX", "*LAX", "CLV", "LDA", "TSX", "*LAS", "LDY", "LDA", "LDX", "*LAX",
+    "CPY", "CMP", "*NOP", "*DCP", "CPY", "CMP", "DEC", "*DCP", "INY", "CMP", "DEX", "*AXS", "CPY", "CMP", "DEC", "*DCP",
+    "BNE", "CMP", "*KIL", "*DCP", "*NOP", "CMP", "DEC", "*DCP", "CLD", "CMP", "*NOP", "*DCP", "*NOP", "CMP", "DEC", "*DCP",
+    "CPX", "SBC", "*NOP", "*ISB", "CPX", "SBC", "INC", "*ISB", "INX", "SBC", "NOP", "*SBC", "CPX", "SBC", "INC", "*ISB",
+    "BEQ", "SBC", "*KIL", "*ISB", "*NOP", "SBC", "INC", "*ISB", "SED", "SBC", "*NOP", "*ISB", "*NOP", "SBC", "INC", "*ISB",
+};
+
+static const uint8_t TRACE_MODES[256] = {
+    IMP, IZX, IMP, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, ACC, IMM, ABS, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPX, ZPX, IMP, ABY, IMP, ABY, ABX, ABX, ABX, ABX,
+    ABS, IZX, IMP, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, ACC, IMM, ABS, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPX, ZPX, IMP, ABY, IMP, ABY, ABX, ABX, ABX, ABX,
+    IMP, IZX, IMP, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, ACC, IMM, ABS, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPX, ZPX, IMP, ABY, IMP, ABY, ABX, ABX, ABX, ABX,
+    IMP, IZX, IMP, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, ACC, IMM, IND, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPX, ZPX, IMP, ABY, IMP, ABY, ABX, ABX, ABX, ABX,
+    IMM, IZX, IMM, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, IMP, IMM, ABS, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPY, ZPY, IMP, ABY, IMP, ABY, ABX, ABX, ABY, ABY,
+    IMM, IZX, IMM, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, IMP, IMM, ABS, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPY, ZPY, IMP, ABY, IMP, ABY, ABX, ABX, ABY, ABY,
+    IMM, IZX, IMM, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, IMP, IMM, ABS, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPX, ZPX, IMP, ABY, IMP, ABY, ABX, ABX, ABX, ABX,
+    IMM, IZX, IMM, IZX, ZP,  ZP,  ZP,  ZP,  IMP, IMM, IMP, IMM, ABS, ABS, ABS, ABS,
+    REL, IZY, IMP, IZY, ZPX, ZPX, ZPX, ZPX, IMP, ABY, IMP, ABY, ABX, ABX, ABX, ABX,
+};
+
+/**
+ * @brief length of an instruction in memory, BRK counts as 1 byte as in nestest
+ *
+ * @param opcode
+ * @return uint8_t
+ */
+static inline uint8_t instruction_length(uint8_t opcode) {
+    switch (TRACE_MODES[opcode]) {
+        case IMP:
+        case ACC:
+            return 1;
+
+        case ABS:
+        case ABX:
+        case ABY:
+        case IND:
+            return 3;
+
+        default:
+            return 2;
+    }
+}
+
+/**
+ * @brief write a number as upper case hex digits
+ *
+ * @param out
+ * @param value
+ * @param digits
+ * @return char* the end of what was written
+ */
+static inline char *put_hex(char *out, uint32_t value, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = "0123456789ABCDEF"[value & 0xf];
+        value >>= 4;
+    }
+
+    return out + digits;
+}
+
+/**
+ * @brief write a number in decimal, right aligned in a field of at least width characters
+ *
+ * @param out
+ * @param value
+ * @param width
+ * @return char* the end of what was written
+ */
+static inline char *put_decimal(char *out, int64_t value, int width) {
+    char digits[24];
+    int count = 0;
+    uint64_t magnitude = value < 0 ? -value : value;
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+        digits[count++] = '-';
+
+    for (int i = count; i < width; i++)
+        *out++ = ' ';
+    while (count)
+        *out++ = digits[--count];
+
+    return out;
+}
+
+/**
+ * @brief write a string, padded with spaces to at least width characters
+ *
+ * @param out
+ * @param text
+ * @param width
+ * @return char* the end of what was written
+ */
+static inline char *put_text(char *out, const char *text, int width) {
+    char *start = out;
+    while (*text)
+        *out++ = *text++;
+    while (out - start < width)
+        *out++ = ' ';
+
+    return out;
+}
+
+/**
+ * @brief address of an entry's memory operand, for the modes that have one
+ *
+ * @param entry
+ * @return uint16_t
+ */
+static uint16_t operand_address(TraceEntry *entry) {
+    uint16_t absolute = entry->opcode[1] | (entry->opcode[2] << 8);
+
+    switch (TRACE_MODES[entry->opcode[0]]) {
+        case ZP:
+            return entry->opcode[1];
+        case ZPX:
+            return (entry->opcode[1] + entry->x) & 0xff;
+        case ZPY:
+            return (entry->opcode[1] + entry->y) & 0xff;
+        case ABX:
+            return (absolute + entry->x) & 0xffff;
+        case ABY:
+            return (absolute + entry->y) & 0xffff;
+        case IZX:
+            return entry->pointer;
+        case IZY:
+            return (entry->pointer + entry->y) & 0xffff;
+        default:
+            return absolute;
+    }
+}
+
+/**
+ * @brief fill in the memory an entry's operand refers to, for the "= value" annotations of text traces
+ *
+ * @param entry
+ * @param peek
+ * @param context passed to peek
+ */
+void read_trace_memory(TraceEntry *entry, TracePeek peek, void *context) {
+    uint8_t zero_page = entry->opcode[1];
+    uint16_t absolute = entry->opcode[1] | (entry->opcode[2] << 8);
+
+    switch (TRACE_MODES[entry->opcode[0]]) {
+        case IZX:
+            zero_page += entry->x;
+            // fall through
+        case IZY:
+            entry->pointer = peek(context, zero_page) | (peek(context, (uint8_t)(zero_page + 1)) << 8);
+            break;
+
+        case IND:
+            // the high byte comes from the start of the page when the pointer is at its end, as on the 6502
+            entry->pointer = peek(context, absolute) |
+                             (peek(context, (absolute & 0xff00) | ((absolute + 1) & 0xff)) << 8);
+            break;
+
+        default:
+            entry->pointer = 0;
+            break;
+    }
+
+    entry->value = peek(context, operand_address(entry));
+    entry->memory = true;
+}
+
+/**
+ * @brief write an instruction the way nestest disassembles it, "= value" annotations only if the entry has
+ * its memory
+ *
+ * @param out
+ * @param entry
+ * @return char* the end of what was written
+ */
+static char *put_operation(char *out, TraceEntry *entry) {
+    uint8_t opcode = entry->opcode[0];
+    uint8_t mode = TRACE_MODES[opcode];
+    uint16_t absolute = entry->opcode[1] | (entry->opcode[2] << 8);
+
+    out = put_text(out, TRACE_MNEMONICS[opcode], 0);
+    switch (mode) {
+        case IMP:
+            return out;
+        case ACC:
+            return put_text(out, " A", 0);
+        case IMM:
+            return put_hex(put_text(out, " #$", 0), entry->opcode[1], 2);
+        case REL:
+            return put_hex(put_text(out, " $", 0), (entry->pc + 2 + (int8_t)entry->opcode[1]) & 0xffff, 4);
+
+        case ZP:
+        case ZPX:
+        case ZPY:
+            out = put_hex(put_text(out, " $", 0), entry->opcode[1], 2);
+            if (mode != ZP)
+                out = put_hex(put_text(out, mode == ZPX ? ",X @ " : ",Y @ ", 0), operand_address(entry), 2);
+            break;
+
+        case ABS:
+        case ABX:
+        case ABY:
+            out = put_hex(put_text(out, " $", 0), absolute, 4);
+            // jumps have no memory operand
+            if (opcode == 0x4c || opcode == 0x20)
+                return out;
+            if (mode != ABS)
+                out = put_hex(put_text(out, mode == ABX ? ",X @ " : ",Y @ ", 0), operand_address(entry), 4);
+            break;
+
+        case IND:
+            out = put_text(put_hex(put_text(out, " ($", 0), absolute, 4), ")", 0);
+            if (entry->memory)
+                out = put_hex(put_text(out, " = ", 0), entry->pointer, 4);
+            return out;
+
+        case IZX:
+            out = put_text(put_hex(put_text(out, " ($", 0), entry->opcode[1], 2), ",X)", 0);
+            out = put_hex(put_text(out, " @ ", 0), (entry->opcode[1] + entry->x) & 0xff, 2);
+            if (entry->memory)
+                out = put_hex(put_text(out, " = ", 0), entry->pointer, 4);
+            break;
+
+        case IZY:
+            out = put_text(put_hex(put_text(out, " ($", 0), entry->opcode[1], 2), "),Y", 0);
+            if (entry->memory)
+                out = put_hex(put_text(put_hex(put_text(out, " = ", 0), entry->pointer, 4), " @ ", 0),
+                              operand_address(entry), 4);
+            break;
+    }
+
+    if (entry->memory)
+        out = put_hex(put_text(out, " = ", 0), entry->value, 2);
+
+    return out;
+}
+
+/**
+ * @brief format a nestest style trace line into a caller provided buffer
+ *
+ * @param entry
+ * @param line
+ * @param size size of line
+ * @return int length of the whole line, as snprintf
+ */
+int format_trace_entry(TraceEntry *entry, char *line, size_t size) {
+    // printf is most of the cost of tracing, so the line is put together by hand, in the nestest layout:
+    // C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+    char text[TRACE_LINE_LENGTH + 32];
+    char *out = put_hex(text, entry->pc, 4);
+    out = put_text(out, "  ", 2);
+
+    char *bytes = out;
+    uint8_t length = instruction_length(entry->opcode[0]);
+    for (int i = 0; i < length; i++) {
+        out = put_hex(out, entry->opcode[i], 2);
+        *out++ = ' ';
+    }
+    while (out - bytes < 9)
+        *out++ = ' ';
+
+    // the * of an unofficial opcode takes the place of the space before the mnemonic
+    char *operation = out;
+    if (TRACE_MNEMONICS[entry->opcode[0]][0] != '*')
+        *out++ = ' ';
+    out = put_operation(out, entry);
+    while (out - operation < 33)
+        *out++ = ' ';
+
+    out = put_hex(put_text(out, "A:", 2), entry->a, 2);
+    out = put_hex(put_text(out, " X:", 3), entry->x, 2);
+    out = put_hex(put_text(out, " Y:", 3), entry->y, 2);
+    out = put_hex(put_text(out, " P:", 3), entry->p, 2);
+    out = put_hex(put_text(out, " SP:", 4), entry->sp, 2);
+    out = put_decimal(put_text(out, " PPU:", 5), entry->scanline, 3);
+    out = put_decimal(put_text(out, ",", 1), entry->dot, 3);
+    out = put_decimal(put_text(out, " CYC:", 5), entry->cycle, 0);
+    *out++ = '\n';
+
+    // the same result as snprintf: as much as fits, and the length of the whole line
+    int written = out - text;
+    if (size > 0) {
+        size_t copied = (size_t)written < size - 1 ? written : size - 1;
+        memcpy(line, text, copied);
+        line[copied] = '\0';
+    }
+
+    return written;
+}
+
+/**
+ * @brief pack an entry into a binary record: pc, the 3 opcode bytes, a, x, y, p and sp, then 6 bytes holding
+ * the low 31 bits of the cycle and the ppu position in the frame ((scanline + 1) * 341 + dot) above them
+ *
+ * @param entry
+ * @param record TRACE_RECORD_SIZE bytes
+ */
+void pack_trace_entry(TraceEntry *entry, uint8_t *record) {
+    record[0] = entry->pc & 0xff;
+    record[1] = entry->pc >> 8;
+    record[2] = entry->opcode[0];
+    record[3] = entry->opcode[1];
+    record[4] = entry->opcode[2];
+    record[5] = entry->a;
+    record[6] = entry->x;
+    record[7] = entry->y;
+    record[8] = entry->p;
+    record[9] = entry->sp;
+
+    uint64_t position = (entry->scanline + 1) * 341 + entry->dot;
+    uint64_t timing = (entry->cycle & 0x7fffffff) | (position << 31);
+    for (int i = 0; i < 6; i++)
+        record[10 + i] = (timing >> (8 * i)) & 0xff;
+}
+
+/**
+ * @brief unpack a binary record
+ *
+ * @param record TRACE_RECORD_SIZE bytes
+ * @param previous_cycle cycle of the record before, to restore the high bits of the cycle
+ * @param entry
+ */
+void unpack_trace_entry(const uint8_t *record, uint64_t previous_cycle, TraceEntry *entry) {
+    entry->pc = record[0] | (record[1] << 8);
+    entry->opcode[0] = record[2];
+    entry->opcode[1] = record[3];
+    entry->opcode[2] = record[4];
+    entry->a = record[5];
+    entry->x = record[6];
+    entry->y = record[7];
+    entry->p = record[8];
+    entry->sp = record[9];
+    entry->memory = false;
+    entry->pointer = 0;
+    entry->value = 0;
+
+    uint64_t timing = 0;
+    for (int i = 0; i < 6; i++)
+        timing |= (uint64_t)record[10 + i] << (8 * i);
+
+    uint32_t position = timing >> 31;
+    entry->scanline = position / 341 - 1;
+    entry->dot = position % 341;
+
+    // cycles only go forward, and far less than 2^31 of them pass between two instructions
+    entry->cycle = (previous_cycle & ~(uint64_t)0x7fffffff) | (timing & 0x7fffffff);
+    if (entry->cycle < previous_cycle)
+        entry->cycle += (uint64_t)1 << 31;
+}
+
+/**
+ * @brief read and check the header of a binary trace
+ *
+ * @param file
+ * @return bool false if the file is not a binary trace this version can read
+ */
+bool read_trace_header(FILE *file) {
+    uint8_t header[16];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header))
+        return false;
+
+    uint32_t version = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+    uint32_t record_size = header[12] | (header[13] << 8) | (header[14] << 16) | ((uint32_t)header[15] << 24);
+
+    return memcmp(header, TRACE_MAGIC, 8) == 0 && version == TRACE_VERSION && record_size == TRACE_RECORD_SIZE;
+}
@@ -0,0 +1,162 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_LINE_LENGTH 128        // longest line a trace keeps, including the newline
+#define TRACE_BUFFER_SIZE (1 << 20)  // file traces are written out in blocks of this size
+
+// binary traces start with a 16 byte header: the magic, then the version and record size as little endian
+// uint32s. each instruction is one record, see pack_trace_entry
+#define TRACE_MAGIC "NESTRACE"
+#define TRACE_VERSION 1
+#define TRACE_RECORD_SIZE 16
+
+// what a trace records for each instruction, before it runs
+typedef struct TraceEntry {
+    uint16_t pc;
+    uint8_t opcode[3];
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t p;
+    uint8_t sp;
+    int16_t scanline;  // -1 (pre-render) to 260
+    uint16_t dot;
+    uint64_t cycle;    // cpu cycles
+
+    // MEMORY OPERAND
+    bool memory;       // pointer and value were read, binary records leave them out
+    uint16_t pointer;  // the address read from zero page for ($00,X) and ($00),Y, the target of JMP ($0000)
+    uint8_t value;     // memory at the operand's address
+} TraceEntry;
+
+// reads memory for a trace without side effects
+typedef uint8_t (*TracePeek)(void *context, uint16_t address);
+
+typedef struct Trace {
+    // FILE SINK
+    FILE *file;          // NULL when the trace only keeps the last lines in memory
+    bool binary;         // the file gets TRACE_RECORD_SIZE records instead of text lines
+    char *buffer;        // TRACE_BUFFER_SIZE bytes of lines not written to the file yet
+    uint32_t buffered;
+
+    // RING SINK
+    char *ring;          // ring_lines lines of TRACE_LINE_LENGTH characters, overwritten oldest first
+    uint32_t ring_lines;
+
+    uint64_t lines;      // lines traced so far
+
+} Trace;
+
+/**
+ * @brief creates a trace that writes every line to a file through a large buffer
+ *
+ * @param file
+ * @return Trace*
+ */
+Trace *InitFileTrace(FILE *file);
+
+/**
+ * @brief creates a trace that writes a binary record for every instruction to a file, through a large buffer
+ *
+ * @param file
+ * @return Trace*
+ */
+Trace *InitBinaryTrace(FILE *file);
+
+/**
+ * @brief creates a trace that only keeps the last lines in memory
+ *
+ * @param lines
+ * @return Trace*
+ */
+Trace *InitRingTrace(uint32_t lines);
+
+/**
+ * @brief add a line to the trace, without allocating
+ *
+ * @param trace
+ * @param line ends with a newline
+ * @param length
+ */
+void write_trace_line(Trace *trace, const char *line, uint32_t length);
+
+/**
+ * @brief add a binary record to the trace, without allocating
+ *
+ * @param trace
+ * @param record TRACE_RECORD_SIZE bytes
+ */
+void write_trace_record(Trace *trace, const uint8_t *record);
+
+/**
+ * @brief write the lines kept by a ring trace to a file, oldest first
+ *
+ * @param trace
+ * @param file
+ */
+void dump_trace(Trace *trace, FILE *file);
+
+/**
+ * @brief write out the buffered lines of a file trace
+ *
+ * @param trace
+ */
+void flush_trace(Trace *trace);
+
+/**
+ * @brief flush the trace and free it, the file is left open
+ *
+ * @param trace
+ */
+void close_trace(Trace *trace);
+
+/**
+ * @brief fill in the memory an entry's operand refers to, for the "= value" annotations of text traces
+ *
+ * @param entry
+ * @param peek
+ * @param context passed to peek
+ */
+void read_trace_memory(TraceEntry *entry, TracePeek peek, void *context);
+
+/**
+ * @brief format a nestest style trace line into a caller provided buffer
+ *
+ * @param entry
+ * @param line
+ * @param size size of line
+ * @return int length of the whole line, as snprintf
+ */
+int format_trace_entry(TraceEntry *entry, char *line, size_t size);
+
+/**
+ * @brief pack an entry into a binary record: pc, the 3 opcode bytes, a, x, y, p and sp, then 6 bytes holding
+ * the low 31 bits of the cycle and the ppu position in the frame ((scanline + 1) * 341 + dot) above them
+ *
+ * @param entry
+ * @param record TRACE_RECORD_SIZE bytes
+ */
+void pack_trace_entry(TraceEntry *entry, uint8_t *record);
+
+/**
+ * @brief unpack a binary record
+ *
+ * @param record TRACE_RECORD_SIZE bytes
+ * @param previous_cycle cycle of the record before, to restore the high bits of the cycle
+ * @param entry
+ */
+void unpack_trace_entry(const uint8_t *record, uint64_t previous_cycle, TraceEntry *entry);
+
+/**
+ * @brief read and check the header of a binary trace
+ *
+ * @param file
+ * @return bool false if the file is not a binary trace this version can read
+ */
+bool read_trace_header(FILE *file);
+
+#endif
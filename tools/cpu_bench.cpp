@@ -0,0 +1,126 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/2C02.h"
+#include "../src/6502.h"
+#include "../src/bus.hpp"
+#include "../src/mapper.hpp"
+
+// runs the same rom on three machines, one per cpu core plus one with the block cache, and compares
+// their speed and final state
+
+typedef uint32_t (*StepFunction)(State6502 *cpu);
+
+/**
+ * @brief run_frame with the cpu core passed in
+ *
+ * @param bus
+ * @param step core to run each instruction with, NULL for clock_bus (and the block cache)
+ */
+static void run_frame_with(Bus *bus, StepFunction step) {
+    if (!step) {
+        run_frame(bus);
+        return;
+    }
+
+    while (!bus->ppu->frame_complete)
+        clock_bus_with(bus, step);
+
+    bus->ppu->frame_complete = false;
+}
+
+/**
+ * @brief time a number of frames on one machine
+ *
+ * @param bus
+ * @param step
+ * @param frames
+ * @return double cpu seconds per instruction
+ */
+static double time_frames(Bus *bus, StepFunction step, long frames) {
+    uint64_t instructions = bus->cpu->instructions;
+    clock_t start = clock();
+    for (long frame = 0; frame < frames; frame++)
+        run_frame_with(bus, step);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return seconds / (bus->cpu->instructions - instructions);
+}
+
+/**
+ * @brief compare the cpu, cpu ram and last frame of two machines
+ *
+ * @param a
+ * @param b
+ * @return bool
+ */
+static bool same_state(Bus *a, Bus *b) {
+    State6502 *x = a->cpu;
+    State6502 *y = b->cpu;
+    return x->instructions == y->instructions && x->pc == y->pc && x->a == y->a && x->x == y->x && x->y == y->y &&
+           x->sp == y->sp && a->cpu_clock == b->cpu_clock && memcmp(a->cpu_ram, b->cpu_ram, 0x800) == 0 &&
+           memcmp(a->ppu->frame_buffer, b->ppu->frame_buffer, 256 * 240) == 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s rom [frames] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    long frames = argc > 2 ? atol(argv[2]) : 300;
+    int rounds = argc > 3 ? atoi(argv[3]) : 5;
+
+    Bus *switch_bus = InitMachine(argv[1], NULL);
+    Bus *table_bus = InitMachine(argv[1], NULL);
+    Bus *block_bus = InitMachine(argv[1], NULL);
+    if (!switch_bus || !table_bus || !block_bus) {
+        fprintf(stderr, "Unable to load rom %s.\n", argv[1]);
+        return 1;
+    }
+
+    // get past the title screen setup so most of the time is spent in the game loop
+    for (int frame = 0; frame < 60; frame++) {
+        run_frame_with(switch_bus, step_cpu_switch);
+        run_frame_with(table_bus, step_cpu_table);
+        run_frame_with(block_bus, NULL);
+    }
+
+    // caching starts after the warm up, the decoding happens during the first timed round
+    enable_block_cache(block_bus->cpu, block_bus->mapper->prg_rom, block_bus->mapper->prg_rom_size);
+    uint64_t warm_instructions = block_bus->cpu->instructions;
+
+    // alternate the cores and keep the best round of each, the machines stay in step
+    double best_switch = 0;
+    double best_table = 0;
+    double best_block = 0;
+    for (int round = 0; round < rounds; round++) {
+        double switch_time = time_frames(switch_bus, step_cpu_switch, frames);
+        double table_time = time_frames(table_bus, step_cpu_table, frames);
+        double block_time = time_frames(block_bus, NULL, frames);
+
+        if (round == 0 || switch_time < best_switch)
+            best_switch = switch_time;
+        if (round == 0 || table_time < best_table)
+            best_table = table_time;
+        if (round == 0 || block_time < best_block)
+            best_block = block_time;
+    }
+
+    State6502 *a = switch_bus->cpu;
+    bool same = same_state(switch_bus, table_bus) && same_state(switch_bus, block_bus);
+
+    printf("frames: %ld x %d rounds, %llu instructions per core\n", frames, rounds, (unsigned long long)a->instructions);
+    printf("switch core: %.1f ns/instruction, %.0f instructions/second\n", best_switch * 1e9, 1 / best_switch);
+    printf("table core:  %.1f ns/instruction, %.0f instructions/second\n", best_table * 1e9, 1 / best_table);
+    printf("block cache: %.1f ns/instruction, %.0f instructions/second, %.1f%% of instructions cached\n",
+           best_block * 1e9, 1 / best_block, 100.0 * block_bus->cpu->block_cache->instructions / (a->instructions - warm_instructions));
+    printf("speedup over the switch core: table %.2fx, block cache %.2fx\n", best_switch / best_table, best_switch / best_block);
+    printf("final state: %s\n", same ? "identical" : "DIFFERENT");
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/2C02.h"
+#include "../src/6502.h"
+#include "../src/bus.hpp"
+#include "../src/mapper.hpp"
+#include "../src/movie.h"
+#include "../src/profile.h"
+
+// plays a movie headless and reports how long each frame took, split among the cpu, ppu, mapper and drawing
+// the frame. build with -DNES_PROFILE for the split, without it only emulation and output are timed
+
+/**
+ * @brief wall clock seconds
+ *
+ * @return double
+ */
+static double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    // parse arguments: rom movie [frames] [--csv FILE] [--label TEXT] [--block-cache] [--idle-skip]
+    char *positional[3] = {NULL, NULL, NULL};
+    int num_positional = 0;
+    char *csv_path = NULL;
+    const char *label = "";
+    bool block_cache = false;
+    bool idle_skip = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+            csv_path = argv[++i];
+        else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc)
+            label = argv[++i];
+        else if (strcmp(argv[i], "--block-cache") == 0)
+            block_cache = true;
+        else if (strcmp(argv[i], "--idle-skip") == 0)
+            idle_skip = true;
+        else if (num_positional < 3)
+            positional[num_positional++] = argv[i];
+    }
+
+    if (!positional[1]) {
+        fprintf(stderr, "Usage: %s rom movie [frames] [--csv FILE] [--label TEXT] [--block-cache] [--idle-skip]\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t rom_crc;
+    Bus *bus = InitMachine(positional[0], &rom_crc);
+    if (!bus) {
+        fprintf(stderr, "Unable to load rom %s.\n", positional[0]);
+        return 1;
+    }
+
+    Movie *movie = read_movie_file(positional[1]);
+    if (!movie) {
+        fprintf(stderr, "Unable to read movie %s.\n", positional[1]);
+        return 1;
+    }
+    if (movie->rom_crc != rom_crc || !start_movie(movie, bus)) {
+        fprintf(stderr, "Movie %s was recorded with another rom.\n", positional[1]);
+        return 1;
+    }
+
+    // past the end of the movie the last buttons stay held
+    long frames = positional[2] ? atol(positional[2]) : movie->frames;
+
+    if (block_cache)
+        enable_block_cache(bus->cpu, bus->mapper->prg_rom, bus->mapper->prg_rom_size);
+    if (idle_skip)
+        enable_idle_loop_skip(bus->cpu);
+
+    // frames are drawn at the window's default scale
+    int scale = 2;
+    uint32_t *pixels = (uint32_t *)malloc(256 * scale * 240 * scale * sizeof(uint32_t));
+
+    reset_profile();
+    double emulation_seconds = 0;
+    double output_seconds = 0;
+    uint64_t emulation_ticks = 0;
+
+    for (long frame = 0; frame < frames; frame++) {
+        play_movie_frame(movie, bus);
+
+        double start = now();
+        uint64_t start_ticks = profile_ticks();
+        run_frame(bus);
+        emulation_ticks += profile_ticks() - start_ticks;
+        double middle = now();
+
+        draw_frame(bus->ppu, pixels, 256 * scale, scale);
+        output_seconds += now() - middle;
+        emulation_seconds += middle - start;
+    }
+
+    double emulation_ms = 1000 * emulation_seconds / frames;
+    double output_ms = 1000 * output_seconds / frames;
+    uint32_t frame_crc = rom_crc32(bus->ppu->frame_buffer, 256 * 240);
+
+    printf("%s, %s: %ld frames, %.1f frames/second\n", positional[0], positional[1], frames,
+           frames / (emulation_seconds + output_seconds));
+
+#ifdef NES_PROFILE
+    // the ticks of each part as a share of the emulation's wall time
+    double ppu_ms = emulation_ms * profile.ticks[PROFILE_PPU] / emulation_ticks;
+    double mapper_ms = emulation_ms * profile.ticks[PROFILE_MAPPER] / emulation_ticks;
+    double cpu_ms = emulation_ms - ppu_ms - mapper_ms;
+    printf("per frame: cpu %.3f ms, ppu %.3f ms, mapper %.3f ms, output %.3f ms\n", cpu_ms, ppu_ms, mapper_ms, output_ms);
+#else
+    (void)emulation_ticks;
+    printf("per frame: emulation %.3f ms, output %.3f ms (build with -DNES_PROFILE to split the emulation up)\n",
+           emulation_ms, output_ms);
+#endif
+    printf("last frame crc32: %08x\n", frame_crc);
+
+    // one row per run, to track over commits
+    if (csv_path) {
+        FILE *csv = fopen(csv_path, "a+");
+        if (!csv) {
+            fprintf(stderr, "Unable to open %s.\n", csv_path);
+            return 1;
+        }
+
+        fseek(csv, 0, SEEK_END);
+        if (ftell(csv) == 0)
+            fprintf(csv, "label,rom,movie,frames,frames_per_second,emulation_ms,cpu_ms,ppu_ms,mapper_ms,output_ms,frame_crc32\n");
+
+        fprintf(csv, "%s,%s,%s,%ld,%.1f,%.4f,", label, positional[0], positional[1], frames,
+                frames / (emulation_seconds + output_seconds), emulation_ms);
+#ifdef NES_PROFILE
+        fprintf(csv, "%.4f,%.4f,%.4f,", cpu_ms, ppu_ms, mapper_ms);
+#else
+        fprintf(csv, ",,,");
+#endif
+        fprintf(csv, "%.4f,%08x\n", output_ms, frame_crc);
+        fclose(csv);
+    }
+
+    free(pixels);
+    free_movie(movie);
+    return 0;
+}
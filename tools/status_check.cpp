@@ -0,0 +1,128 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/2C02.h"
+#include "../src/6502.h"
+#include "../src/bus.hpp"
+#include "../src/mapper.hpp"
+#include "../src/savestate.h"
+
+// checks cycles_until_status_change, which --idle-skip relies on, against clock_ppu run one dot at a time:
+// PPUSTATUS must not change before the bound is used up. the ppu is checked at points spread over a run of
+// the rom, then in set up positions that were once got wrong
+
+/**
+ * @brief step the ppu through the cycles cycles_until_status_change gives and see if PPUSTATUS changed,
+ * leaving the machine as it was
+ *
+ * @param bus
+ * @param state scratch save state
+ * @param label printed with a failure
+ * @return bool false if the status changed before the bound
+ */
+static bool check_bound(Bus *bus, SaveState *state, const char *label) {
+    State2C02 *ppu = bus->ppu;
+    save_state(bus, state);
+
+    int scanline = ppu->scanline;
+    int cycle = ppu->cycles;
+    uint8_t status = ppu->status.reg & 0xe0;
+    uint32_t bound = cycles_until_status_change(ppu);
+
+    uint32_t changed = UINT32_MAX;
+    for (uint32_t dot = 1; dot <= bound; dot++) {
+        clock_ppu(ppu);
+        if ((ppu->status.reg & 0xe0) != status) {
+            changed = dot;
+            break;
+        }
+    }
+
+    if (!load_state(bus, state)) {
+        fprintf(stderr, "Unable to restore the machine.\n");
+        exit(1);
+    }
+
+    if (changed != UINT32_MAX) {
+        printf("%s: scanline %d, cycle %d: bound %u, but PPUSTATUS changed after %u cycles\n", label, scanline, cycle,
+               bound, changed);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s rom [frames] [checks per frame]\n", argv[0]);
+        return 1;
+    }
+
+    long frames = argc > 2 ? atol(argv[2]) : 300;
+    long spacing = 30000 / (argc > 3 ? atol(argv[3]) : 20);
+
+    Bus *bus = InitMachine(argv[1], NULL);
+    if (!bus) {
+        fprintf(stderr, "Unable to load rom %s.\n", argv[1]);
+        return 1;
+    }
+
+    SaveState *state = InitSaveState();
+    SaveState *outer = InitSaveState();
+    State2C02 *ppu = bus->ppu;
+    long checks = 0;
+    long failures = 0;
+
+    // wherever the game happens to be every few thousand cpu cycles
+    for (long frame = 0; frame < frames; frame++) {
+        uint64_t next_check = bus->cpu_clock;
+        while (!ppu->frame_complete) {
+            clock_bus(bus);
+            if (bus->cpu_clock >= next_check) {
+                catch_up_ppu(bus, bus->cpu_clock);
+                failures += !check_bound(bus, state, "run");
+                checks++;
+                next_check = bus->cpu_clock + spacing;
+            }
+        }
+        ppu->frame_complete = false;
+    }
+
+    // the pre-render scanline clears all three flags at cycle 1
+    save_state(bus, outer);
+    ppu->scanline = -1;
+    ppu->cycles = 0;
+    ppu->status.vblank = 1;
+    failures += !check_bound(bus, state, "pre-render with vblank set");
+    checks++;
+    load_state(bus, outer);
+
+    // sprite 0 found at cycle 257 is drawn on the next scanline, a hit there is only a few dozen cycles away
+    ppu->scanline = 47;
+    ppu->cycles = 300;
+    ppu->status.sprite_zero_hit = 0;
+    ppu->mask.background_enable = 1;
+    ppu->mask.sprite_enable = 1;
+    ppu->control.sprite_height = 0;
+    ppu->primary_oam[0].y = 40;
+    for (int n = 1; n < 64; n++)
+        ppu->primary_oam[n].y = 0xff;
+    ppu->sprite_index_dirty = true;
+    ppu->sprite_zero_on_scanline = true;
+    uint32_t bound = cycles_until_status_change(ppu);
+    if (bound > 341 - 300) {
+        printf("sprite 0 drawn on the next scanline: bound %u is past the start of the scanline\n", bound);
+        failures++;
+    }
+    failures += !check_bound(bus, state, "sprite 0 drawn on the next scanline");
+    checks += 2;
+    load_state(bus, outer);
+
+    printf("%ld checks, %ld failed\n", checks, failures);
+
+    free_save_state(state);
+    free_save_state(outer);
+    return failures > 0;
+}
@@ -0,0 +1,59 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/trace.h"
+
+// turns a binary trace (main --trace-binary) back into the text lines --trace would have written
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace [first] [count]\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t first = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+    uint64_t count = argc > 3 ? strtoull(argv[3], NULL, 10) : UINT64_MAX;
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Unable to open trace %s.\n", argv[1]);
+        return 1;
+    }
+
+    if (!read_trace_header(file)) {
+        fprintf(stderr, "%s is not a binary trace.\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+
+    // records are read in blocks and the lines go out through the same buffered sink as a text trace
+    Trace *output = InitFileTrace(stdout);
+    uint8_t *records = (uint8_t *)malloc(4096 * TRACE_RECORD_SIZE);
+    uint64_t index = 0;
+    uint64_t cycle = 0;
+
+    size_t read;
+    while (index < first + count && (read = fread(records, TRACE_RECORD_SIZE, 4096, file)) > 0) {
+        for (size_t i = 0; i < read && index < first + count; i++, index++) {
+            // every record is unpacked, the cycle of each one depends on the one before
+            TraceEntry entry;
+            unpack_trace_entry(&records[i * TRACE_RECORD_SIZE], cycle, &entry);
+            cycle = entry.cycle;
+
+            if (index < first)
+                continue;
+
+            char line[TRACE_LINE_LENGTH];
+            int length = format_trace_entry(&entry, line, sizeof(line));
+            write_trace_line(output, line, length < TRACE_LINE_LENGTH ? length : TRACE_LINE_LENGTH - 1);
+        }
+    }
+
+    close_trace(output);
+    free(records);
+    fclose(file);
+
+    return 0;
+}